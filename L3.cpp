@@ -1,61 +1,138 @@
+#include <cassert>
+
 #include "L3.h"
 
 namespace L3 {
 
-Item::Item (ItemType n)
-  : type {n}{}
-
-int64_t Item::getval() {
-    return 0;
+Node TreePool::make(Item i, Op o, Node l, Node r) {
+    Node n = root.size();
+    root.push_back(i);
+    op.push_back(o);
+    left.push_back(l);
+    right.push_back(r);
+    id_in_func.push_back(0);
+    return n;
 }
 
-Var::Var (int n)
-  : Item(ItemType::VAR) {
-      var = n;
-  return ;
+Node TreePool::make_call(Item i, const std::vector<Node>& leaves) {
+    Node n = make(i, Op::call, call_leaves.size(), leaves.size());
+    call_leaves.insert(call_leaves.end(), leaves.begin(), leaves.end());
+    return n;
 }
 
-int64_t Var::getval() {
-    return var;
-}
-
-Num::Num (int64_t n)
-  : Item(ItemType::NUM){
-      num = n;
-  return ;
+int64_t arithmetic(int64_t l, int64_t r, Op op) {
+    uint64_t a = l;
+    uint64_t b = r;
+    switch(op) {
+        case Op::add :
+        case Op::addn :
+        return a + b;
+        case Op::sub :
+        case Op::subn :
+        return a - b;
+        case Op::mult :
+        case Op::multn :
+        return a * b;
+        case Op::band :
+        case Op::bandn :
+        return a & b;
+        case Op::s_l :
+        case Op::s_ln :
+        return a << (b & 63);
+        case Op::s_r :
+        case Op::s_rn :
+        return l >> (b & 63);
+        case Op::c_l :
+        return l < r;
+        case Op::c_le :
+        return l <= r;
+        case Op::c_e :
+        return l == r;
+        case Op::c_g :
+        return l > r;
+        case Op::c_ge :
+        return l >= r;
+        default :
+        assert(0 && "not an arithmetic op");
+        return 0;
+    }
 }
 
-int64_t Num::getval() {
-    return num;
+void Renumber(Function* f) {
+    auto& T = f->trees;
+    f->tree_count = 0;
+    for (auto c : f->contexts) {
+        for (auto t : c->trees) {
+            T.id_in_func[t] = f->tree_count++;
+            if (T.op[t] == Op::label) {
+                f->label_id_map[T.root[t].getval()] = T.id_in_func[t];
+            }
+        }
+    }
 }
 
-Label::Label (int n)
-   : Item(ItemType::LABEL){
-  label = n;
-  return ;
+bool Joins(TreePool& T, const std::vector<Context*>& contexts, Node front) {
+    auto splits = [&](Node t) {
+        return T.op[t] == Op::label || T.op[t] == Op::call;
+    };
+    if (contexts.empty() || splits(front)) {
+        return false;
+    }
+    auto back = contexts.back()->trees.back();
+    return !splits(back) && T.op[back] != Op::br && T.op[back] != Op::cjmp && T.op[back] != Op::ret;
 }
 
-int64_t Label::getval() {
-    return label;
+void Place(Program& p, Function* f, std::vector<Context*>& contexts, const std::vector<Node>& trees) {
+    if (trees.empty()) {
+        return;
+    }
+    if (Joins(f->trees, contexts, trees.front())) {
+        auto& to = contexts.back()->trees;
+        to.insert(to.end(), trees.begin(), trees.end());
+        return;
+    }
+    auto c = p.arena.make<Context>();
+    c->trees = trees;
+    contexts.push_back(c);
 }
 
-FunName::FunName (std::string s)
-    : Item(ItemType::FUN){
-  fun = s;
-  return ;
+bool HoldsLabel(TreePool& T, Node t) {
+    if (T.op[t] == Op::label || T.op[t] == Op::br || T.op[t] == Op::cjmp || T.op[t] == Op::leaf) {
+        return T.op[t] == Op::leaf && T.root[t].type == LABEL;
+    }
+    for (int k = 0; k < T.size(t); k++) {
+        bool ret = T.op[t] == Op::call && k == T.size(t) - 2;
+        if (!ret && HoldsLabel(T, T.leaf(t, k))) {
+            return true;
+        }
+    }
+    return false;
 }
 
-Tree::Tree (Item* i, Op o)
-  : root {i},
-    op {o} {
-        id_in_func = 0;
-        return;
+Node CopyTree(TreePool& from, Node t, TreePool& to, const std::function<Item(Item)>& rename) {
+    auto x = rename(from.root[t]);
+    if (from.op[t] == Op::call) {
+        std::vector<Node> leaves;
+        for (int k = 0; k < from.size(t); k++) {
+            leaves.push_back(CopyTree(from, from.leaf(t, k), to, rename));
+        }
+        return to.make_call(x, leaves);
     }
+    auto l = from.left[t] != NIL ? CopyTree(from, from.left[t], to, rename) : NIL;
+    auto r = from.right[t] != NIL ? CopyTree(from, from.right[t], to, rename) : NIL;
+    return to.make(x, from.op[t], l, r);
+}
 
-Pattern::Pattern (Tile* t)
-  : tile {t} {
-        return;
+Item Program::intern_fun(const std::string& s) {
+    auto it = fun_ids.find(s);
+    if (it != fun_ids.end()) {
+        return Item(ItemType::FUN, it->second);
     }
+    int64_t n = fun_names.size();
+    fun_names.push_back(s);
+    fun_ids.insert(std::pair<std::string, int64_t>(s, n));
+    return Item(ItemType::FUN, n);
+}
 
 
 }
\ No newline at end of file
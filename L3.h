@@ -1,99 +1,118 @@
 #pragma once
 
 #include <array>
+#include <cstdint>
+#include <functional>
 #include <vector>
 #include <string>
 #include <unordered_set>
+#include <unordered_map>
 #include <map>
 #include <set>
 
+#include <arena.h>
+
 
 namespace L3 {
   class Visitor;
   class Itemprinter;
 
   enum Op {add, addn, sub, subn, mult, multn, band, bandn, s_l, s_ln, s_r, s_rn, c_l, c_le, c_e, c_g, c_ge, asmt, load, store, ret, cjmp, br, label, call, leaf};
-  enum ItemType {VAR, NUM, LABEL, FUN};
+  enum ItemType {VAR, NUM, LABEL, FUN, NONE};
 
   /*
-   * items for tree-node construction
+   * items for tree-node construction, a tag with a 64-bit payload passed by value
+   *   VAR   : var encoding of the function
+   *   NUM   : the constant itself
+   *   LABEL : label encoding of the program
+   *   FUN   : callee name interned by the program
    */
   class Item {
     public:
-      Item (ItemType n);
-      virtual int64_t getval();
-
-      ItemType type;
-  };
-
-  class Var : public Item {
-    public:
-      Var (int n);
-      int64_t getval() override;
+      Item ()
+        : type {NONE}, val {0} {}
+      Item (ItemType t, int64_t v)
+        : type {t}, val {v} {}
 
-      int var;  // vars are encoded as interger in the parser
-  };
+      int64_t getval() const { return val; }
+      bool operator== (const Item& i) const { return type == i.type && val == i.val; }
+      bool operator!= (const Item& i) const { return type != i.type || val != i.val; }
 
-  class Num : public Item {
-    public:
-      Num (int64_t n);
-      int64_t getval() override;
-
-      int64_t num;
+      ItemType type;
+      int64_t val;
   };
 
-  class Label : public Item {
-    public:
-      Label (int n);
-      int64_t getval() override;
+  inline Item Var (int64_t n) { return Item(ItemType::VAR, n); }
+  inline Item Num (int64_t n) { return Item(ItemType::NUM, n); }
+  inline Item Label (int64_t n) { return Item(ItemType::LABEL, n); }
 
-      int label;
-  };
-
-  class FunName : public Item {
-    public:
-      FunName (std::string s);
-
-      std::string fun;
-  };
+  /* l op r as the machine computes it, wrapping around and shifting by the low 6 bits, a compare gives 1 or 0, an op in its n form as the op */
+  int64_t arithmetic(int64_t l, int64_t r, Op op);
 
 
   /*
    * tree node
    */
-   class Tree;
-   class Pattern;
-
+   typedef uint32_t Node;  // index of a node in the pools of a function
+   const Node NIL = UINT32_MAX;
+
+   class Function;
+   class Match;
+   class Program;
+
+   /*
+    * a rule of instruction selection, tiles are shared and keep nothing of the trees they cover
+    *   cover : L2 instructions of covering node i, -1 when it does not match,
+    *           fills m with what the tile prints and kids with the subtrees it leaves to be covered on their own
+    *   rewrite : simplification of node i before it is covered, true when the tree changed
+    *   variant : which form of the tile a match is, for the tile profile
+    */
    class Tile {
      public :
-       virtual Pattern* try_to_cover(Tree *i, std::vector<Tile*>& all) = 0;
-       virtual std::string printer() = 0;
+       virtual int cover(Function* f, Node i, Match& m, std::vector<Node>& kids) { return -1; }
+       virtual std::string printer(Program& p, Function* f, const Match& m) { return ""; }
+       virtual bool rewrite(Function* f, Node i) { return false; }
+       virtual std::string variant(const Match& m) { return ""; }
+
+       int id = -1;  // slot of the tile in the tile profile
    };
 
-   class Tree { //Tree of instructions
+   class Match {  // a tile covering a node, the operands of the instructions it prints
      public:
-       Tree (Item* i, Op o);
-       friend class Tree;
-
-       Item* root;
-       Op op;
-       int id_in_func;
-       std::vector<Tree*> leaves;
+       Tile* tile = NULL;
+       Node node = NIL;
+       Op op = Op::leaf;
+       int64_t n = 0;
+       Item items[3];
    };
 
-   class Pattern { //Tree of generated pattern
+   class TreePool { //Trees of instructions of a function, one slot per node
      public:
-       Pattern (Tile* t);
-       friend class Pattern;
-
-       Tile* tile;
-       std::vector<Pattern*> leaves;
+       Node make(Item i, Op o, Node l = NIL, Node r = NIL);
+       Node make_call(Item i, const std::vector<Node>& leaves);
+
+       int size(Node n) const {  // number of leaves
+         return op[n] == Op::call ? right[n] : (left[n] != NIL) + (right[n] != NIL);
+       }
+       Node& leaf(Node n, int k) {
+         return op[n] == Op::call ? call_leaves[left[n] + k] : k == 0 ? left[n] : right[n];
+       }
+       Node back(Node n) const {
+         return op[n] == Op::call ? call_leaves[left[n] + right[n] - 1] : right[n] != NIL ? right[n] : left[n];
+       }
+
+       std::vector<Item> root;
+       std::vector<Op> op;
+       std::vector<Node> left;          // first leaf, or first slot in call_leaves for a call
+       std::vector<Node> right;         // second leaf, or number of leaves for a call
+       std::vector<int> id_in_func;
+       std::vector<Node> call_leaves;   // args, return label and callee of every call
    };
 
   class Context{
     public:
-      std::vector<Tree *> trees;
-      std::vector<Pattern *> patterns;
+      std::vector<Node> trees;
+      std::vector<Match> matches;   // tiles of the trees in the order their code is emitted
   };
   
   /*
@@ -102,9 +121,10 @@ namespace L3 {
   class Function{
     public:
       std::string name;
-      std::vector<Item *> args;
+      std::vector<Item> args;
 
       std::vector<Context *> contexts;
+      TreePool trees;
 
       std::map<std::string, int> label_map; // label encoding
       std::map<std::string, int> var_map;   // var encoding
@@ -113,11 +133,33 @@ namespace L3 {
       int tree_count;
   };
 
+  void Renumber(Function* f);   // id_in_func of the trees in the order of the contexts, for trees added since parsing
+
+  /*
+   * contexts rebuilt from runs of trees
+   *   a run joins the last context unless that ends in a jump, a return, a label or a call, or the run starts with a label or a call,
+   *   so a call is alone in its context and a label starts one, as the tiles expect
+   */
+  bool Joins(TreePool& T, const std::vector<Context*>& contexts, Node front);
+  void Place(Program& p, Function* f, std::vector<Context*>& contexts, const std::vector<Node>& trees);
+
+  bool HoldsLabel(TreePool& T, Node t);   // a label read as a value, not jumped to nor returned to by a call
+
+  /* a copy of tree t of pool from in pool to, each item of it renamed */
+  Node CopyTree(TreePool& from, Node t, TreePool& to, const std::function<Item(Item)>& rename);
+
   class Program{
     public:
       std::vector<Function *> functions;
       std::string entryPointLabel;
       int global_label_count;
+
+      Arena arena;  // owns every function, context and tile of the program
+
+      Item intern_fun(const std::string& s);  // callee names are carried by items as ids
+
+      std::vector<std::string> fun_names;
+      std::unordered_map<std::string, int64_t> fun_ids;
   };
 
   
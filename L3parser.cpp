@@ -18,6 +18,7 @@
 
 #include <L3.h>
 #include <L3parser.h>
+#include <report.h>
 
 namespace pegtl = tao::TAO_PEGTL_NAMESPACE;
 
@@ -28,7 +29,7 @@ namespace L3 {
   /* 
    * Tokens parsed
    */ 
-  std::vector<Item *> parsed_items;
+  std::vector<Item> parsed_items;
   std::vector<Op> parsed_ops;
 
   /* 
@@ -392,11 +393,12 @@ namespace L3 {
        //    p.entryPointLabel = in.string();
        //    p.global_label_count = 0;
        //}
-        auto newF = new Function();
+        report.begin_function(in.string());   // the previous function ends here
+        auto newF = p.arena.make<Function>();
         newF->name = in.string();
         newF->var_count = 0;
         newF->tree_count = 0;
-        auto newC = new Context();
+        auto newC = p.arena.make<Context>();
         newF->contexts.push_back(newC);
         p.functions.push_back(newF);
     }
@@ -407,7 +409,7 @@ namespace L3 {
     static void apply( const Input & in, Program & p){
       auto currentF = p.functions.back();
       currentF->args = parsed_items;
-      parsed_items = std::vector<Item *>();
+      parsed_items = std::vector<Item>();
     }
   };
 
@@ -427,7 +429,7 @@ namespace L3 {
           currentF->var_map.insert(std::pair<std::string, int>(s, n));
       }
 
-      auto v = new Var(n);
+      auto v = Var(n);
       parsed_items.push_back(v);
     }
   };
@@ -435,7 +437,7 @@ namespace L3 {
   template<> struct action < number > {
     template< typename Input >
     static void apply( const Input & in, Program & p){
-      auto n = new Num(std::stoll(in.string()));
+      auto n = Num(std::stoll(in.string()));
       parsed_items.push_back(n);
     }
   };
@@ -456,7 +458,7 @@ namespace L3 {
           currentF->label_map.insert(std::pair<std::string, int>(s, n));
       }
 
-      auto l = new Label(n);
+      auto l = Label(n);
       parsed_items.push_back(l);
     }
   };
@@ -464,7 +466,7 @@ namespace L3 {
   template<> struct action < instruction_function_name_rule > {
     template< typename Input >
     static void apply( const Input & in, Program & p){
-      auto n = new FunName(in.string());
+      auto n = p.intern_fun(in.string());
       parsed_items.push_back(n);
     }
   };
@@ -472,7 +474,7 @@ namespace L3 {
   template<> struct action < str_print > {
     template< typename Input >
     static void apply( const Input & in, Program & p){
-      auto n = new FunName(in.string());
+      auto n = p.intern_fun(in.string());
       parsed_items.push_back(n);
     }
   };
@@ -480,7 +482,7 @@ namespace L3 {
   template<> struct action < str_input > {
     template< typename Input >
     static void apply( const Input & in, Program & p){
-      auto n = new FunName(in.string());
+      auto n = p.intern_fun(in.string());
       parsed_items.push_back(n);
     }
   };
@@ -488,7 +490,7 @@ namespace L3 {
   template<> struct action < str_allocate > {
     template< typename Input >
     static void apply( const Input & in, Program & p){
-      auto n = new FunName(in.string());
+      auto n = p.intern_fun(in.string());
       parsed_items.push_back(n);
     }
   };
@@ -496,7 +498,7 @@ namespace L3 {
   template<> struct action < str_error > {
     template< typename Input >
     static void apply( const Input & in, Program & p){
-      auto n = new FunName(in.string());
+      auto n = p.intern_fun(in.string());
       parsed_items.push_back(n);
     }
   };
@@ -578,25 +580,6 @@ namespace L3 {
     }
   };
 
-  int64_t arithmetic(int64_t l, int64_t r, Op op) {
-      switch(op) {
-          case Op::add :
-          return l + r;
-          case Op::sub :
-          return l - r;
-          case Op::mult :
-          return l * r;
-          case Op::band :
-          return l & r;
-          case Op::s_l :
-          return l << r;
-          case Op::s_r :
-          return l >> r;
-      }
-      assert(0);
-      return 0;
-  }
-
   template<> struct action < Instruction_op_assignment_rule > {
     template< typename Input >
 	  static void apply( const Input & in, Program & p){
@@ -622,62 +605,58 @@ namespace L3 {
           }
       } else if (op == Op::c_l || op == Op::c_le || op == Op::c_e){
           ifSwap = false;
-      } else if (right->type == NUM && left->type == NUM) {  // both constants, turned to a simple assignment
-          int64_t n = arithmetic(left->getval(), right->getval(), op);
-          auto num = new Num(n);
-          auto lf = new Tree(num, Op::leaf);
-          auto t = new Tree(root, Op::asmt);
-          t->leaves.push_back(lf);
-          t->id_in_func = (currentF->tree_count)++;
+      } else if (right.type == NUM && left.type == NUM) {  // both constants, turned to a simple assignment
+          int64_t n = arithmetic(left.getval(), right.getval(), op);
+          auto& T = currentF->trees;
+          auto lf = T.make(Num(n), Op::leaf);
+          auto t = T.make(root, Op::asmt, lf);
+          T.id_in_func[t] = (currentF->tree_count)++;
           currentC->trees.push_back(t);
           return;
       } else if (op == Op::add || op == Op::mult || op == Op::band) {
-          if(left->type == NUM || right->type == root->type && right->getval() == root->getval()) {  // no NUM on the left, same-name var must be on the left
+          if(left.type == NUM || right == root) {  // no NUM on the left, same-name var must be on the left
               ifSwap = true;
           }
-      } else if (right->type == root->type && right->getval() == root->getval()) {  // [v <- 3 - v]
+      } else if (right == root) {  // [v <- 3 - v]
           int n = ++(currentF->var_count);
-          auto v = new Var(n);
-          auto a = new Tree(v, Op::asmt);
-          auto lf = new Tree(root, Op::leaf);
-          a->leaves.push_back(lf);
-          a->id_in_func = (currentF->tree_count)++;
+          auto v = Var(n);
+          auto& T = currentF->trees;
+          auto lf = T.make(root, Op::leaf);
+          auto a = T.make(v, Op::asmt, lf);
+          T.id_in_func[a] = (currentF->tree_count)++;
           currentC->trees.push_back(a);
 
-          auto l = new Tree(left, Op::leaf);
-          auto r = new Tree(v, Op::leaf);
-          auto t = new Tree(root, op);
-          t->leaves.push_back(l);
-          t->leaves.push_back(r);
-          t->id_in_func = (currentF->tree_count)++;
+          auto l = T.make(left, Op::leaf);
+          auto r = T.make(v, Op::leaf);
+          auto t = T.make(root, op, l, r);
+          T.id_in_func[t] = (currentF->tree_count)++;
           currentC->trees.push_back(t);
           return;
       }
 
-      auto l = new Tree(left, Op::leaf);
-      auto r = new Tree(right, Op::leaf);
-      auto t = new Tree(root, op);
       if (ifSwap) {
-          auto temp = l;
-          l = r;
-          r = temp;
+          auto temp = left;
+          left = right;
+          right = temp;
       }
-      if (r->root->type == NUM && t->op < c_l) {  //distinguish [v + v] / [v + c]
+      if (right.type == NUM && op < c_l) {  //distinguish [v + v] / [v + c]
           int temp;
-          temp = t->op;
+          temp = op;
           temp++;
-          t->op = static_cast<Op>(temp);
+          op = static_cast<Op>(temp);
       }
-      if (t->op == Op::addn && r->root->getval() == 0 && t->root->getval() == l->root->getval()) { return; }
-      if (t->op == Op::multn && r->root->getval() == 1 && t->root->getval() == l->root->getval()) { return; }
-      if (t->op == Op::multn && r->root->getval() == 2) { t->op = Op::s_ln; r->root = new Num(1); }
-      if (t->op == Op::multn && r->root->getval() == 4) { t->op = Op::s_ln; r->root = new Num(2); }
-      if (t->op == Op::multn && r->root->getval() == 8) { t->op = Op::s_ln; r->root = new Num(3); }
-
-      t->leaves.push_back(l);
-      t->leaves.push_back(r);
+      if (op == Op::addn && right.getval() == 0 && root == left) { return; }
+      if (op == Op::multn && right.getval() == 1 && root == left) { return; }
+      if (op == Op::multn && right.getval() == 2) { op = Op::s_ln; right = Num(1); }
+      if (op == Op::multn && right.getval() == 4) { op = Op::s_ln; right = Num(2); }
+      if (op == Op::multn && right.getval() == 8) { op = Op::s_ln; right = Num(3); }
+
+      auto& T = currentF->trees;
+      auto l = T.make(left, Op::leaf);
+      auto r = T.make(right, Op::leaf);
+      auto t = T.make(root, op, l, r);
       
-      t->id_in_func = (currentF->tree_count)++;
+      T.id_in_func[t] = (currentF->tree_count)++;
       currentC->trees.push_back(t);
     }
   };
@@ -693,10 +672,10 @@ namespace L3 {
       auto root = parsed_items.back();
       parsed_items.pop_back();
 
-      auto l = new Tree(lf, Op::leaf);
-      auto t = new Tree(root, Op::asmt);
-      t->leaves.push_back(l);
-      t->id_in_func = (currentF->tree_count)++;
+      auto& T = currentF->trees;
+      auto l = T.make(lf, Op::leaf);
+      auto t = T.make(root, Op::asmt, l);
+      T.id_in_func[t] = (currentF->tree_count)++;
       currentC->trees.push_back(t);
     }
   };
@@ -712,10 +691,10 @@ namespace L3 {
       auto root = parsed_items.back();
       parsed_items.pop_back();
 
-      auto l = new Tree(lf, Op::leaf);
-      auto t = new Tree(root, Op::load);
-      t->leaves.push_back(l);
-      t->id_in_func = (currentF->tree_count)++;
+      auto& T = currentF->trees;
+      auto l = T.make(lf, Op::leaf);
+      auto t = T.make(root, Op::load, l);
+      T.id_in_func[t] = (currentF->tree_count)++;
       currentC->trees.push_back(t);
     }
   };
@@ -731,12 +710,11 @@ namespace L3 {
       auto left = parsed_items.back();
       parsed_items.pop_back();
 
-      auto l = new Tree(left, Op::leaf);
-      auto r = new Tree(right, Op::leaf);
-      auto t = new Tree(NULL, Op::store);
-      t->leaves.push_back(l);
-      t->leaves.push_back(r);
-      t->id_in_func = (currentF->tree_count)++;
+      auto& T = currentF->trees;
+      auto l = T.make(left, Op::leaf);
+      auto r = T.make(right, Op::leaf);
+      auto t = T.make(Item(), Op::store, l, r);
+      T.id_in_func[t] = (currentF->tree_count)++;
       currentC->trees.push_back(t);
     }
   };
@@ -747,11 +725,12 @@ namespace L3 {
       auto currentF = p.functions.back();
       auto currentC = currentF->contexts.back(); 
 
-      auto t = new Tree(NULL, Op::ret);
-      t->id_in_func = (currentF->tree_count)++;
+      auto& T = currentF->trees;
+      auto t = T.make(Item(), Op::ret);
+      T.id_in_func[t] = (currentF->tree_count)++;
       currentC->trees.push_back(t);
 
-      auto newC = new Context();
+      auto newC = p.arena.make<Context>();
       currentF->contexts.push_back(newC);
     }
   };
@@ -765,13 +744,13 @@ namespace L3 {
       auto lf = parsed_items.back();
       parsed_items.pop_back();
 
-      auto t = new Tree(NULL, Op::ret);
-      auto l = new Tree(lf, Op::leaf);
-      t->leaves.push_back(l);
-      t->id_in_func = (currentF->tree_count)++;
+      auto& T = currentF->trees;
+      auto l = T.make(lf, Op::leaf);
+      auto t = T.make(Item(), Op::ret, l);
+      T.id_in_func[t] = (currentF->tree_count)++;
       currentC->trees.push_back(t);
 
-      auto newC = new Context();
+      auto newC = p.arena.make<Context>();
       currentF->contexts.push_back(newC);
     }
   };
@@ -788,25 +767,26 @@ namespace L3 {
       auto cond = parsed_items.back();
       parsed_items.pop_back();
 
-      if(cond->type == ItemType::NUM) {
-          if(cond->getval() != 0) {  // goto
-              auto t = new Tree(label, Op::br);
-              t->id_in_func = (currentF->tree_count)++;
+      if(cond.type == ItemType::NUM) {
+          if(cond.getval() != 0) {  // goto
+              auto& T = currentF->trees;
+              auto t = T.make(label, Op::br);
+              T.id_in_func[t] = (currentF->tree_count)++;
               currentC->trees.push_back(t);
 
-              auto newC = new Context();
+              auto newC = p.arena.make<Context>();
               currentF->contexts.push_back(newC);
           }
           return;
       }
 
-      auto t = new Tree(label, Op::cjmp);
-      auto l = new Tree(cond, Op::leaf);
-      t->leaves.push_back(l);
-      t->id_in_func = (currentF->tree_count)++;
+      auto& T = currentF->trees;
+      auto l = T.make(cond, Op::leaf);
+      auto t = T.make(label, Op::cjmp, l);
+      T.id_in_func[t] = (currentF->tree_count)++;
       currentC->trees.push_back(t);
 
-      auto newC = new Context();
+      auto newC = p.arena.make<Context>();
       currentF->contexts.push_back(newC);
     }
   };
@@ -820,11 +800,12 @@ namespace L3 {
       auto label = parsed_items.back();
       parsed_items.pop_back();
 
-      auto t = new Tree(label, Op::br);
-      t->id_in_func = (currentF->tree_count)++;
+      auto& T = currentF->trees;
+      auto t = T.make(label, Op::br);
+      T.id_in_func[t] = (currentF->tree_count)++;
       currentC->trees.push_back(t);
 
-      auto newC = new Context();
+      auto newC = p.arena.make<Context>();
       currentF->contexts.push_back(newC);
     }
   };
@@ -845,21 +826,22 @@ namespace L3 {
           currentF->label_map.insert(std::pair<std::string, int>(s, n));
       }
 
-      auto l = new Label(n);
-      auto t = new Tree(l, Op::label);
-      t->id_in_func = (currentF->tree_count)++;
-      currentF->label_id_map.insert(std::pair<int, int>(n, t->id_in_func));
+      auto l = Label(n);
+      auto& T = currentF->trees;
+      auto t = T.make(l, Op::label);
+      T.id_in_func[t] = (currentF->tree_count)++;
+      currentF->label_id_map.insert(std::pair<int, int>(n, T.id_in_func[t]));
 
       auto currentC = currentF->contexts.back();
       if(currentC->trees.empty()) {
           currentC->trees.push_back(t);
       } else {
-          auto newC = new Context();
+          auto newC = p.arena.make<Context>();
           newC->trees.push_back(t);
           currentF->contexts.push_back(newC);
       }
       
-      auto newC1 = new Context();
+      auto newC1 = p.arena.make<Context>();
       currentF->contexts.push_back(newC1);
     }
   };
@@ -872,32 +854,31 @@ namespace L3 {
       auto callee = parsed_items.front();
       parsed_items.erase (parsed_items.begin());
       auto args = parsed_items;
-      parsed_items = std::vector<Item *>();
+      parsed_items = std::vector<Item>();
 
       int n = ++(p.global_label_count);
-      auto l = new Label(n);
-      auto t = new Tree(NULL, Op::call);
+      auto l = Label(n);
+      auto& T = currentF->trees;
+      std::vector<Node> leaves;
       
       for (auto i : args) {
-          auto leaf = new Tree(i, Op::leaf);
-          t->leaves.push_back(leaf);
+          leaves.push_back(T.make(i, Op::leaf));
       }
-      auto leaf = new Tree(l, Op::leaf);
-      t->leaves.push_back(leaf);
-      leaf = new Tree(callee, Op::leaf);
-      t->leaves.push_back(leaf);
-      t->id_in_func = (currentF->tree_count)++;
+      leaves.push_back(T.make(l, Op::leaf));
+      leaves.push_back(T.make(callee, Op::leaf));
+      auto t = T.make_call(Item(), leaves);
+      T.id_in_func[t] = (currentF->tree_count)++;
 
       auto currentC = currentF->contexts.back();
       if(currentC->trees.empty()) {
           currentC->trees.push_back(t);
       } else {
-          auto newC = new Context();
+          auto newC = p.arena.make<Context>();
           newC->trees.push_back(t);
           currentF->contexts.push_back(newC);
       }
 
-      auto newC1 = new Context();
+      auto newC1 = p.arena.make<Context>();
       currentF->contexts.push_back(newC1);
     }
   };
@@ -912,32 +893,31 @@ namespace L3 {
       auto callee = parsed_items.front();
       parsed_items.erase (parsed_items.begin());
       auto args = parsed_items;
-      parsed_items = std::vector<Item *>();
+      parsed_items = std::vector<Item>();
 
       int n = ++(p.global_label_count);
-      auto l = new Label(n);
-      auto t = new Tree(dst, Op::call);
+      auto l = Label(n);
+      auto& T = currentF->trees;
+      std::vector<Node> leaves;
       
       for (auto i : args) {
-          auto leaf = new Tree(i, Op::leaf);
-          t->leaves.push_back(leaf);
+          leaves.push_back(T.make(i, Op::leaf));
       }
-      auto leaf = new Tree(l, Op::leaf);
-      t->leaves.push_back(leaf);
-      leaf = new Tree(callee, Op::leaf);
-      t->leaves.push_back(leaf);
-      t->id_in_func = (currentF->tree_count)++;
+      leaves.push_back(T.make(l, Op::leaf));
+      leaves.push_back(T.make(callee, Op::leaf));
+      auto t = T.make_call(dst, leaves);
+      T.id_in_func[t] = (currentF->tree_count)++;
 
       auto currentC = currentF->contexts.back();
       if(currentC->trees.empty()) {
           currentC->trees.push_back(t);
       } else {
-          auto newC = new Context();
+          auto newC = p.arena.make<Context>();
           newC->trees.push_back(t);
           currentF->contexts.push_back(newC);
       }
 
-      auto newC1 = new Context();
+      auto newC1 = p.arena.make<Context>();
       currentF->contexts.push_back(newC1);
     }
   };
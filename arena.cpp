@@ -0,0 +1,64 @@
+#include <cstdlib>
+
+#include <arena.h>
+
+namespace L3 {
+
+Arena::Arena ()
+  : allocations {0},
+    used {0},
+    reserved {0},
+    cur {NULL},
+    end {NULL} {}
+
+Arena::Arena (Arena&& other)
+  : allocations {other.allocations},
+    used {other.used},
+    reserved {other.reserved},
+    blocks {std::move(other.blocks)},
+    dtors {std::move(other.dtors)},
+    cur {other.cur},
+    end {other.end} {
+        other.blocks.clear();
+        other.dtors.clear();
+        other.cur = other.end = NULL;
+    }
+
+Arena::~Arena () {
+    release();
+}
+
+void* Arena::allocate(std::size_t size, std::size_t align) {
+    std::uintptr_t p = (reinterpret_cast<std::uintptr_t>(cur) + align - 1) & ~(std::uintptr_t)(align - 1);
+    if (cur == NULL || p + size > reinterpret_cast<std::uintptr_t>(end)) {
+        std::size_t n = size + align > BLOCK ? size + align : BLOCK;  // oversized nodes get a block of their own
+        char* b = static_cast<char*>(std::malloc(n));
+        if (b == NULL) {
+            throw std::bad_alloc();
+        }
+        blocks.push_back(b);
+        reserved += n;
+        cur = b;
+        end = b + n;
+        p = (reinterpret_cast<std::uintptr_t>(cur) + align - 1) & ~(std::uintptr_t)(align - 1);
+    }
+    cur = reinterpret_cast<char*>(p + size);
+    allocations++;
+    used += size;
+    return reinterpret_cast<void*>(p);
+}
+
+void Arena::release() {
+    for (auto it = dtors.rbegin(); it != dtors.rend(); ++it) {
+        it->run(it->obj);
+    }
+    dtors.clear();
+    for (auto b : blocks) {
+        std::free(b);
+    }
+    blocks.clear();
+    cur = end = NULL;
+    allocations = used = reserved = 0;
+}
+
+}
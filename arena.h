@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+#include <type_traits>
+
+namespace L3 {
+
+  /*
+   * bump allocator owning every IR node of a compilation unit
+   */
+  class Arena {
+    public:
+      Arena ();
+      Arena (Arena&& other);
+      Arena (const Arena&) = delete;
+      Arena& operator= (const Arena&) = delete;
+      ~Arena ();
+
+      void* allocate(std::size_t size, std::size_t align);
+      void release();  // run the pending destructors and free all blocks in one shot
+
+      template<typename T, typename... Args>
+      T* make(Args&&... args) {
+        T* t = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        if (!std::is_trivially_destructible<T>::value) {  // vectors, maps and strings inside the node
+          dtors.push_back(Dtor {t, [](void* p) { static_cast<T*>(p)->~T(); }});
+        }
+        return t;
+      }
+
+      int64_t allocations;  // objects handed out
+      int64_t used;         // bytes handed out
+      int64_t reserved;     // bytes taken from malloc
+
+    private:
+      struct Dtor {
+        void* obj;
+        void (*run)(void*);
+      };
+
+      static const std::size_t BLOCK = 64 * 1024;
+
+      std::vector<char*> blocks;
+      std::vector<Dtor> dtors;
+      char* cur;
+      char* end;
+  };
+
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace L3 {
+
+  /*
+   * dense bit matrix, one row of 64-bit words per instruction and one bit per var
+   *   rows are contiguous so the word loops below vectorize
+   */
+  class BitMatrix {
+    public:
+      BitMatrix (int rows, int bits)
+        : width {(bits + 63) / 64},
+          words ((std::size_t)rows * ((bits + 63) / 64), 0) {}
+
+      uint64_t* row(int i) { return words.data() + (std::size_t)i * width; }
+      const uint64_t* row(int i) const { return words.data() + (std::size_t)i * width; }
+
+      bool test(int i, int b) const { return (row(i)[b >> 6] >> (b & 63)) & 1; }
+      void set(int i, int b) { row(i)[b >> 6] |= (uint64_t)1 << (b & 63); }
+      void reset(int i, int b) { row(i)[b >> 6] &= ~((uint64_t)1 << (b & 63)); }
+
+      /* row(dst) |= src, src being a row of this matrix or of another one of the same width */
+      void unite(int dst, const uint64_t* src) {
+        uint64_t* d = row(dst);
+        for (int w = 0; w < width; w++) {
+          d[w] |= src[w];
+        }
+      }
+
+      /* row(dst) = a, returns whether row(dst) changed */
+      bool assign(int dst, const uint64_t* a) {
+        uint64_t* d = row(dst);
+        uint64_t diff = 0;
+        for (int w = 0; w < width; w++) {
+          diff |= d[w] ^ a[w];
+          d[w] = a[w];
+        }
+        return diff != 0;
+      }
+
+      /* row(dst) = a | b, returns whether row(dst) changed */
+      bool assign(int dst, const uint64_t* a, const uint64_t* b) {
+        uint64_t* d = row(dst);
+        uint64_t diff = 0;
+        for (int w = 0; w < width; w++) {
+          uint64_t v = a[w] | b[w];
+          diff |= d[w] ^ v;
+          d[w] = v;
+        }
+        return diff != 0;
+      }
+
+      void clear(int i) {
+        uint64_t* d = row(i);
+        for (int w = 0; w < width; w++) {
+          d[w] = 0;
+        }
+      }
+
+      void fill(int i) {
+        uint64_t* d = row(i);
+        for (int w = 0; w < width; w++) {
+          d[w] = ~(uint64_t)0;
+        }
+      }
+
+      /* row(dst) &= src */
+      void intersect(int dst, const uint64_t* src) {
+        uint64_t* d = row(dst);
+        for (int w = 0; w < width; w++) {
+          d[w] &= src[w];
+        }
+      }
+
+      /* row(dst) = gen | (src & ~kill), returns whether row(dst) changed */
+      bool transfer(int dst, const uint64_t* gen, const uint64_t* src, const uint64_t* kill) {
+        uint64_t* d = row(dst);
+        uint64_t diff = 0;
+        for (int w = 0; w < width; w++) {
+          uint64_t v = gen[w] | (src[w] & ~kill[w]);
+          diff |= d[w] ^ v;
+          d[w] = v;
+        }
+        return diff != 0;
+      }
+
+      int width;  // words per row
+      std::vector<uint64_t> words;
+  };
+
+}
@@ -0,0 +1,103 @@
+#include <algorithm>
+
+#include <cfg.h>
+
+namespace L3 {
+
+CFG::CFG (Program& p, Function* f)
+  : size {f->tree_count},
+    inst (f->tree_count, NIL),
+    block_of (f->tree_count, 0) {
+    auto& T = f->trees;
+    for (auto c : f->contexts) {
+        for (auto t : c->trees) {
+            inst[T.id_in_func[t]] = t;
+        }
+    }
+
+    /* successors of each instruction: the next one if it falls through, and a jump target */
+    std::vector<bool> falls (size, true);
+    std::vector<int> target (size, -1);
+    std::vector<bool> leader (size + 1, false);
+    leader[0] = true;
+    leader[size] = true;
+    for (int i = 0; i < size; i++) {
+        auto t = inst[i];
+        if (t == NIL) {
+            continue;
+        }
+        if (T.op[t] == Op::ret) {
+            falls[i] = false;
+        } else if (T.op[t] == Op::call) {
+            auto callee = T.root[T.back(t)];
+            if (callee.type == FUN && p.fun_names[callee.getval()][0] == 't') {  // tensor-error never returns
+                falls[i] = false;
+            }
+        } else if (T.op[t] == Op::br || T.op[t] == Op::cjmp) {
+            falls[i] = T.op[t] == Op::cjmp;
+            target[i] = f->label_id_map.find(T.root[t].getval())->second;
+            leader[target[i]] = true;
+        } else if (T.op[t] == Op::label) {
+            leader[i] = true;
+        }
+        if (!falls[i] || target[i] >= 0) {
+            leader[i + 1] = true;
+        }
+    }
+
+    /* blocks */
+    for (int i = 0; i < size; i++) {
+        if (leader[i]) {
+            first.push_back(i);
+        }
+        block_of[i] = first.size() - 1;
+        if (leader[i + 1]) {
+            last.push_back(i);
+        }
+    }
+
+    int n = blocks();
+    succ.resize(n);
+    pred.resize(n);
+    for (int b = 0; b < n; b++) {
+        int i = last[b];
+        if (target[i] >= 0) {
+            succ[b].push_back(block_of[target[i]]);
+        }
+        if (falls[i] && i + 1 < size && (target[i] < 0 || block_of[target[i]] != b + 1)) {
+            succ[b].push_back(b + 1);
+        }
+        for (auto s : succ[b]) {
+            pred[s].push_back(b);
+        }
+    }
+
+    /* reverse postorder from the entry block */
+    std::vector<bool> seen (n, false);
+    std::vector<std::pair<int, int>> stack;  // block, next successor to visit
+    if (n > 0) {
+        stack.push_back({0, 0});
+        seen[0] = true;
+    }
+    while (!stack.empty()) {
+        auto& top = stack.back();
+        if (top.second < (int)succ[top.first].size()) {
+            int s = succ[top.first][top.second++];
+            if (!seen[s]) {
+                seen[s] = true;
+                stack.push_back({s, 0});
+            }
+        } else {
+            rpo.push_back(top.first);
+            stack.pop_back();
+        }
+    }
+    std::reverse(rpo.begin(), rpo.end());
+    for (int b = 0; b < n; b++) {
+        if (!seen[b]) {
+            rpo.push_back(b);
+        }
+    }
+}
+
+}
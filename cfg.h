@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vector>
+
+#include <L3.h>
+
+namespace L3 {
+
+  /*
+   * control flow graph of a function
+   *   instructions are the trees numbered by id_in_func, blocks are maximal runs of them
+   *   entered only at the first one and left only at the last one
+   */
+  class CFG {
+    public:
+      CFG (Program& p, Function* f);
+
+      int size;                            // number of instructions
+      std::vector<Node> inst;              // tree of each instruction
+      std::vector<int> block_of;           // block of each instruction
+
+      std::vector<int> first;              // first instruction of each block
+      std::vector<int> last;               // last instruction of each block
+      std::vector<std::vector<int>> succ;
+      std::vector<std::vector<int>> pred;
+      std::vector<int> rpo;                // reachable blocks in reverse postorder, then the unreachable ones
+
+      int blocks() const { return first.size(); }
+  };
+
+}
@@ -5,23 +5,13 @@
 
 #include <code_generator.h>
 #include <tile.h>
+#include <report.h>
 
 using namespace std;
 
 namespace L3{
 
-  /* post order traversal */
-  std::string print(Pattern* pt) {
-      std::string s;
-      while(!pt->leaves.empty()) {
-          s += print(pt->leaves.back());
-          pt->leaves.pop_back();
-      }
-      s += pt->tile->printer();
-      return s;
-  }
-
-  void GenerateCode(Program p){
+  void GenerateCode(Program &p){
 
     /* 
      * Open the output file.
@@ -35,6 +25,7 @@ namespace L3{
     outputFile << "(" << p.entryPointLabel << "\n";
     
     for(auto f : p.functions) {
+        report.begin_function(f->name);
         outputFile << "(" << f->name << "\n";
 
         int n = f->args.size();
@@ -45,20 +36,21 @@ namespace L3{
 	    int stackarg = n > 6 ? (n-6) : 0;
 
         for(int i = 0; i < regarg; ++i) {
-			outputFile << " %v" << (f->args)[i]->getval() << regs[i];
+			outputFile << " %v" << (f->args)[i].getval() << regs[i];
 	    }
 
 	    for(int i = 0; i < stackarg; ++i) {
-            outputFile << " %v" << (f->args)[6 + i]->getval() << " <- stack-arg " << 8 * (n - i - 7) << "\n";
+            outputFile << " %v" << (f->args)[6 + i].getval() << " <- stack-arg " << 8 * (n - i - 7) << "\n";
 	    }
 
 		for(auto c : f->contexts) {
-			for(auto pt : c->patterns) {
-				outputFile << print(pt);
+			for(auto& m : c->matches) {
+				outputFile << m.tile->printer(p, f, m);
 			}
 		}
 
         outputFile << ")\n";
+        report.end_function();
     }
 
     outputFile << ")\n";
@@ -4,6 +4,6 @@
 
 namespace L3 {
 
-  void GenerateCode(Program p);
+  void GenerateCode(Program &p);
 
 }
@@ -16,11 +16,22 @@
 #include <L3parser.h>
 #include <tile.h>
 #include <code_generator.h>
+#include <inline.h>
+#include <sccp.h>
+#include <licm.h>
+#include <induction.h>
+#include <unroll.h>
 #include <merge.h>
+#include <fold.h>
+#include <passes.h>
+#include <report.h>
 
 
 void print_help (char *progName){
-  std::cerr << "Usage: " << progName << " [-v] [-g 0|1] [-O 0|1|2] SOURCE" << std::endl;
+  std::cerr << "Usage: " << progName << " [-v] [-j] [-t] [-g 0|1] [-O 0|1|2|3] SOURCE" << std::endl;
+  std::cerr << "  -v  report time, allocations and peak RSS of each phase and function" << std::endl;
+  std::cerr << "  -j  the same report as JSON, on the standard output" << std::endl;
+  std::cerr << "  -t  count and time the attempts and matches of each tile, with the trees left to the basic tiles" << std::endl;
   return ;
 }
 
@@ -30,7 +41,9 @@ int main(
   ){
   auto enable_code_generator = true;
   int32_t optLevel = 0;
-  bool verbose;
+  bool verbose = false;
+  bool json = false;
+  bool tileProfile = false;
 
   /* 
    * Check the compiler arguments.
@@ -40,7 +53,7 @@ int main(
     return 1;
   }
   int32_t opt;
-  while ((opt = getopt(argc, argv, "vg:O:")) != -1) {
+  while ((opt = getopt(argc, argv, "vjtg:O:")) != -1) {
     switch (opt){
       case 'O':
         optLevel = strtoul(optarg, NULL, 0);
@@ -54,6 +67,15 @@ int main(
         verbose = true;
         break ;
 
+      case 'j':
+        verbose = true;
+        json = true;
+        break ;
+
+      case 't':
+        tileProfile = true;
+        break ;
+
       default:
         print_help(argv[0]);
         return 1;
@@ -63,23 +85,76 @@ int main(
   /*
    * Parse the input file.
    */
+  L3::report.enabled = verbose;
+  L3::report.begin("parse");
   auto p = L3::ParseFile(argv[optind]);
+  L3::report.end();
 
   /*
-   * Code optimizations (optional)
+   * Code optimizations (optional) and tiling, as enabled by the -O level
    */
-  L3::MergeTree(p);
-  L3::MaximalMunch(p);
+  L3::PassManager passes (optLevel);
+  auto inliner = passes.add<L3::InlinePass>();
+  auto sccp = passes.add<L3::SccpPass>();
+  auto licm = passes.add<L3::LicmPass>();
+  auto iv = passes.add<L3::InductionPass>();
+  auto unroll = passes.add<L3::UnrollPass>();
+  auto merge = passes.add<L3::MergePass>();
+  auto fold = passes.add<L3::FoldPass>();
+  auto tile = passes.add<L3::TilePass>();
+  tile->profile.enabled = tileProfile;
+  passes.run(p);
 
   /* 
    * Print the source program.
    */
+  L3::report.begin("emit");
   L3::GenerateCode(p);
+  L3::report.end();
   if (verbose){
-    for (auto f : p.functions){
-      //TODO
+    std::cerr << "passes at -O" << optLevel << ":";
+    for (auto pass : passes.schedule()){
+      std::cerr << " " << pass->name;
+    }
+    std::cerr << std::endl;
+    auto& inlined = inliner->stats;
+    std::cerr << "inline: " << inlined.inlined << " of " << inlined.calls << " calls inlined, " << inlined.trees << " trees copied, "
+              << inlined.returns << " returns turned into jumps" << std::endl;
+    auto& propagated = sccp->stats;
+    std::cerr << "sccp: " << propagated.constants << " constant reads, " << propagated.gotos << " branches always taken, "
+              << propagated.dropped << " never taken, " << propagated.unreachable << " unreachable trees, "
+              << propagated.labels << " unreferenced labels, " << propagated.phis << " phis, "
+              << propagated.evaluations << " evaluations" << std::endl;
+    auto& hoisted = licm->stats;
+    std::cerr << "licm: " << hoisted.loops << " loops (" << hoisted.nested << " nested), " << hoisted.preheaders << " preheaders, "
+              << hoisted.hoisted << " invariant trees hoisted (" << hoisted.loads << " loads)" << std::endl;
+    auto& inductions = iv->stats;
+    std::cerr << "iv: " << inductions.basic << " counters, " << inductions.derived << " derived vars (" << inductions.reduced << " reduced), "
+              << inductions.tests << " compares on a reduced var, " << inductions.removed << " counters removed" << std::endl;
+    auto& unrolled = unroll->stats;
+    std::cerr << "unroll: " << unrolled.counted << " counted loops, " << unrolled.unrolled << " unrolled into "
+              << unrolled.copies << " copies (" << unrolled.trees << " trees), " << unrolled.jumps << " jumps and labels between copies removed" << std::endl;
+    auto& merged = merge->stats;
+    std::cerr << "merge: " << merged.dead << " dead trees (" << merged.dead_later << " after the first round), "
+              << merged.merged << " merged trees (" << merged.merged_later << " after the first round), "
+              << merged.rounds << " rounds at most, " << merged.live_updates << " liveness block updates" << std::endl;
+    auto& folded = fold->stats;
+    std::cerr << "fold: " << folded.folded << " constant operations (" << folded.compares << " compares), "
+              << folded.identities << " identities, " << folded.moves << " self moves removed" << std::endl;
+    auto& numbered = tile->values;
+    std::cerr << "lvn: " << numbered.reused << " repeated expressions read from a var (" << numbered.hoisted << " computed ahead, "
+              << numbered.across << " from a dominating context), " << numbered.moves << " self moves removed, "
+              << numbered.trials << " rewrites priced (" << numbered.rejected << " undone), " << numbered.joins << " joins" << std::endl;
+    if (json){
+      L3::report.json(std::cout);
+    } else {
+      L3::report.print(std::cerr);
     }
   }
 
+  if (tileProfile){
+    tile->profile.print(std::cerr);
+  }
+
   return 0;
 }
\ No newline at end of file
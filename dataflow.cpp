@@ -0,0 +1,116 @@
+#include <deque>
+#include <algorithm>
+
+#include <dataflow.h>
+
+namespace L3 {
+
+Dataflow::Dataflow (CFG& g, int bits, Direction dir, Meet meet)
+  : g {g},
+    dir {dir},
+    meet {meet},
+    GEN (g.blocks(), bits),
+    KILL (g.blocks(), bits),
+    IN (g.blocks(), bits),
+    OUT (g.blocks(), bits),
+    visits {0},
+    rank (g.blocks(), g.blocks()) {
+    for (int k = 0; k < (int)g.rpo.size(); k++) {
+        rank[g.rpo[k]] = dir == BACKWARD ? g.rpo.size() - 1 - k : k;
+    }
+}
+
+void Dataflow::solve() {
+    int n = g.blocks();
+    auto& tail = dir == BACKWARD ? IN : OUT;
+    for (int b = 0; b < n; b++) {
+        if (meet == INTERSECTION) {
+            tail.fill(b);
+        } else {
+            tail.clear(b);
+        }
+    }
+
+    std::vector<int> words (GEN.width);
+    for (int w = 0; w < GEN.width; w++) {
+        words[w] = w;
+    }
+
+    /* seed in postorder for a backward problem, in reverse postorder for a forward one */
+    if (dir == BACKWARD) {
+        run(std::vector<int> (g.rpo.rbegin(), g.rpo.rend()), words);
+    } else {
+        run(g.rpo, words);
+    }
+}
+
+void Dataflow::update(const std::vector<int>& blocks, const uint64_t* mask) {
+    std::vector<int> seeds (blocks);
+    std::sort(seeds.begin(), seeds.end(), [&](int a, int b) { return rank[a] < rank[b]; });
+    std::vector<int> words;
+    for (int w = 0; w < GEN.width; w++) {
+        if (mask[w]) {
+            words.push_back(w);
+        }
+    }
+    run(seeds, words);
+}
+
+/* the other words of every row are already solved, recomputing only these is enough */
+void Dataflow::run(const std::vector<int>& blocks, const std::vector<int>& words) {
+    int n = g.blocks();
+    bool back = dir == BACKWARD;
+    auto& head = back ? OUT : IN;   // meet side of a block
+    auto& tail = back ? IN : OUT;   // transfer side of a block
+    auto& from = back ? g.succ : g.pred;
+    auto& to = back ? g.pred : g.succ;
+
+    std::deque<int> work (blocks.begin(), blocks.end());
+    std::vector<bool> queued (n, false);
+    for (auto b : blocks) {
+        queued[b] = true;
+    }
+
+    visits = 0;
+    while (!work.empty()) {
+        int b = work.front();
+        work.pop_front();
+        queued[b] = false;
+
+        auto h = head.row(b);
+        auto t = tail.row(b);
+        auto gen = GEN.row(b);
+        auto kill = KILL.row(b);
+        uint64_t diff = 0;
+        for (auto w : words) {
+            uint64_t m = 0;
+            if (!from[b].empty()) {
+                auto it = from[b].begin();
+                m = tail.row(*it)[w];
+                for (++it; it != from[b].end(); ++it) {
+                    if (meet == INTERSECTION) {
+                        m &= tail.row(*it)[w];
+                    } else {
+                        m |= tail.row(*it)[w];
+                    }
+                }
+            }
+            h[w] = m;
+            uint64_t v = gen[w] | (m & ~kill[w]);
+            diff |= t[w] ^ v;
+            t[w] = v;
+        }
+
+        visits++;
+        if (diff) {
+            for (auto s : to[b]) {
+                if (!queued[s]) {
+                    queued[s] = true;
+                    work.push_back(s);
+                }
+            }
+        }
+    }
+}
+
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cfg.h>
+#include <bitmatrix.h>
+
+namespace L3 {
+
+  enum Direction {FORWARD, BACKWARD};
+  enum Meet {UNION, INTERSECTION};
+
+  /*
+   * bit-vector dataflow problem over the blocks of a CFG, solved by a worklist
+   *   the client fills GEN and KILL of each block, solve() leaves the block boundaries in IN and OUT
+   *   backward : OUT[b] = meet IN[s] of the successors,   IN[b] = GEN[b] | (OUT[b] & ~KILL[b])
+   *   forward  : IN[b] = meet OUT[p] of the predecessors,  OUT[b] = GEN[b] | (IN[b] & ~KILL[b])
+   *   the meet over no edge is the empty set
+   *   update() leaves the rest of the solution alone, so the bits to solve again must first be reset to the
+   *   initial value (empty for UNION, full for INTERSECTION) wherever they can change, and all those blocks seeded
+   */
+  class Dataflow {
+    public:
+      Dataflow (CFG& g, int bits, Direction dir, Meet meet);
+
+      void solve();
+      void update(const std::vector<int>& blocks, const uint64_t* mask);  // solve again the bits of mask from these blocks
+
+      CFG& g;
+      Direction dir;
+      Meet meet;
+
+      BitMatrix GEN;
+      BitMatrix KILL;
+      BitMatrix IN;
+      BitMatrix OUT;
+
+      int64_t visits;  // transfer functions evaluated by the last solve() or update()
+
+    private:
+      std::vector<int> rank;  // of each block in the order solve() seeds them, unreachable blocks last
+
+      void run(const std::vector<int>& blocks, const std::vector<int>& words);
+  };
+
+}
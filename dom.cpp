@@ -0,0 +1,100 @@
+#include <dom.h>
+
+namespace L3 {
+
+DomTree::DomTree (CFG& g)
+  : g {g},
+    idom (g.blocks(), -1),
+    children (g.blocks()),
+    frontier (g.blocks()),
+    enter (g.blocks(), -1),
+    leave (g.blocks(), -1) {
+    int n = g.blocks();
+    if (n == 0) {
+        return;
+    }
+    std::vector<int> rank (n, n);
+    for (int k = 0; k < (int)g.rpo.size(); k++) {
+        rank[g.rpo[k]] = k;
+    }
+    auto intersect = [&](int a, int b) {
+        while (a != b) {
+            while (rank[a] > rank[b]) {
+                a = idom[a];
+            }
+            while (rank[b] > rank[a]) {
+                b = idom[b];
+            }
+        }
+        return a;
+    };
+
+    /* the idoms only move up the tree, until they stop */
+    idom[0] = 0;
+    for (bool changed = true; changed; ) {
+        changed = false;
+        for (auto b : g.rpo) {
+            if (b == 0) {
+                continue;
+            }
+            int d = -1;
+            for (auto p : g.pred[b]) {
+                if (idom[p] >= 0) {
+                    d = d < 0 ? p : intersect(p, d);
+                }
+            }
+            if (d != idom[b]) {
+                idom[b] = d;
+                changed = true;
+            }
+        }
+    }
+
+    for (int b = 1; b < n; b++) {
+        if (idom[b] >= 0) {
+            children[idom[b]].push_back(b);
+        }
+    }
+
+    /* a join is in the frontier of every block from its predecessors up to, not including, its idom,
+       the entry joins the function entry to its predecessors */
+    for (int b = 0; b < n; b++) {
+        if (idom[b] < 0 || g.pred[b].size() + (b == 0) < 2) {
+            continue;
+        }
+        for (auto p : g.pred[b]) {
+            if (idom[p] < 0) {
+                continue;
+            }
+            for (int r = p; r != idom[b]; r = idom[r]) {
+                if (frontier[r].empty() || frontier[r].back() != b) {
+                    frontier[r].push_back(b);
+                }
+            }
+        }
+    }
+
+    std::vector<std::pair<int, int>> stack;  // block, next child to visit
+    stack.push_back({0, 0});
+    int clock = 0;
+    enter[0] = clock++;
+    preorder.push_back(0);
+    while (!stack.empty()) {
+        auto& top = stack.back();
+        if (top.second < (int)children[top.first].size()) {
+            int c = children[top.first][top.second++];
+            enter[c] = clock++;
+            preorder.push_back(c);
+            stack.push_back({c, 0});
+        } else {
+            leave[top.first] = clock++;
+            stack.pop_back();
+        }
+    }
+}
+
+bool DomTree::dominates(int a, int b) const {
+    return reachable(a) && reachable(b) && enter[a] <= enter[b] && leave[b] <= leave[a];
+}
+
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <vector>
+
+#include <cfg.h>
+
+namespace L3 {
+
+  /*
+   * dominator tree of the blocks of a CFG, with their dominance frontiers
+   *   idoms are solved on the reverse postorder (Cooper, Harvey, Kennedy), unreachable blocks have none
+   *   and are in nobody's frontier
+   */
+  class DomTree {
+    public:
+      DomTree (CFG& g);
+
+      bool reachable(int b) const { return idom[b] >= 0; }
+      bool dominates(int a, int b) const;   // a on the path from the entry to b in the tree
+
+      CFG& g;
+      std::vector<int> idom;                     // immediate dominator of each block, the entry its own, -1 when unreachable
+      std::vector<std::vector<int>> children;
+      std::vector<std::vector<int>> frontier;
+      std::vector<int> preorder;                 // reachable blocks, a block before the blocks it dominates
+
+    private:
+      std::vector<int> enter;                    // interval of each block in the preorder of the tree
+      std::vector<int> leave;
+  };
+
+}
@@ -0,0 +1,162 @@
+#include <fold.h>
+#include <report.h>
+
+namespace L3 {
+
+    static bool IsNum(TreePool& T, Node i) {
+        return T.op[i] == Op::leaf && T.root[i].type == NUM;
+    }
+
+    static bool IsNum(TreePool& T, Node i, int64_t n) {
+        return IsNum(T, i) && T.root[i].getval() == n;
+    }
+
+    /* the op an aop/sop with a constant on the right is a form of, add for addn */
+    static Op Plain(Op op) {
+        return op <= Op::s_rn && op % 2 ? static_cast<Op>(op - 1) : op;
+    }
+
+    /* as the parser leaves them, the constant of a commutative op on the right, the constant form of an op taking one */
+    static void Normalize(TreePool& T, Node i) {
+        auto op = Plain(T.op[i]);
+        if (op > Op::s_rn) {
+            return;
+        }
+        if ((op == Op::add || op == Op::mult || op == Op::band) && IsNum(T, T.left[i]) && !IsNum(T, T.right[i])) {
+            auto l = T.left[i];
+            T.left[i] = T.right[i];
+            T.right[i] = l;
+        }
+        if (IsNum(T, T.right[i])) {
+            op = static_cast<Op>(op + 1);
+            auto c = T.root[T.right[i]].getval();
+            if (op == Op::multn && (c == 2 || c == 4 || c == 8)) {
+                op = Op::s_ln;
+                T.right[i] = T.make(Num(c == 2 ? 1 : c == 4 ? 2 : 3), Op::leaf);
+            }
+        }
+        T.op[i] = op;
+    }
+
+    /*
+     * what node i computes, a new constant leaf, one of its operands, or i itself
+     *   var : the node feeds a slot taking no constant, the address of a memory access or a callee
+     */
+    static Node Reduce(TreePool& T, Node i, bool var, FoldStats& stats) {
+        auto op = T.op[i];
+        auto l = T.left[i];
+        auto r = T.right[i];
+        if (op == Op::asmt) {   // a constant assigned by a tree merged into its user
+            if (!var && IsNum(T, l)) {
+                stats.folded++;
+                return l;
+            }
+            return i;
+        }
+        if (op > Op::c_e) {
+            return i;
+        }
+        if (IsNum(T, l) && IsNum(T, r)) {
+            stats.folded++;
+            stats.compares += op >= Op::c_l;
+            return T.make(Num(arithmetic(T.root[l].getval(), T.root[r].getval(), op)), Op::leaf);
+        }
+
+        bool same = false;   // x op c is x
+        bool zero = false;   // x op c is 0
+        if (op <= Op::s_rn && op % 2) {
+            auto c = T.root[r].getval();
+            switch(op) {
+                case Op::addn :
+                case Op::subn :
+                same = c == 0;
+                break;
+                case Op::multn :
+                same = c == 1;
+                zero = c == 0;
+                break;
+                case Op::bandn :
+                same = c == -1;
+                zero = c == 0;
+                break;
+                default :   // shifts by the low 6 bits of c
+                same = (c & 63) == 0;
+            }
+        } else if (op == Op::s_l || op == Op::s_r) {
+            zero = IsNum(T, l, 0);
+        }
+        if (same) {
+            stats.identities++;
+            return l;
+        }
+        if (zero) {
+            stats.identities++;
+            return T.make(Num(0), Op::leaf);
+        }
+        return i;
+    }
+
+    /* fold the trees merged into node i, bottom up */
+    static void FoldNode(TreePool& T, Node i, FoldStats& stats) {
+        int n = T.size(i);
+        for (int k = 0; k < n; k++) {
+            Node c = T.leaf(i, k);
+            if (T.op[c] == Op::leaf) {
+                continue;
+            }
+            FoldNode(T, c, stats);
+            bool var = (k == 0 && (T.op[i] == Op::load || T.op[i] == Op::store)) || (T.op[i] == Op::call && k == n - 1);
+            Node r = Reduce(T, c, var, stats);
+            if (r == c) {
+                continue;
+            }
+            if (var && IsNum(T, r)) {   // c keeps its var, assigned the constant
+                T.op[c] = Op::asmt;
+                T.left[c] = r;
+                T.right[c] = NIL;
+                r = c;
+            }
+            T.leaf(i, k) = r;
+        }
+        Normalize(T, i);
+    }
+
+    FoldStats FoldTrees(Program& p) {
+        FoldStats stats;
+        for (auto f : p.functions) {
+            report.begin_function(f->name);
+            auto& T = f->trees;
+            for (auto c : f->contexts) {
+                int n = c->trees.size();
+                int k = 0;
+                for (int i = 0; i < n; i++) {
+                    Node t = c->trees[i];
+                    FoldNode(T, t, stats);
+                    Node r = T.op[t] == Op::asmt ? t : Reduce(T, t, false, stats);
+                    if (r != t && T.op[r] == Op::leaf) {
+                        T.op[t] = Op::asmt;
+                        T.left[t] = r;
+                        T.right[t] = NIL;
+                    } else if (r != t) {   // the operand is a tree itself, computed into the var of t
+                        T.op[t] = T.op[r];
+                        T.left[t] = T.left[r];
+                        T.right[t] = T.right[r];
+                    }
+                    if (i < n - 1 && T.op[t] == Op::asmt && T.op[T.left[t]] == Op::leaf && T.root[T.left[t]] == T.root[t]) {   // the last tree of a context is kept
+                        stats.moves++;
+                        continue;
+                    }
+                    c->trees[k++] = t;
+                }
+                c->trees.resize(k);
+            }
+            report.end_function();
+        }
+        return stats;
+    }
+
+    void FoldPass::run(Program& p, Analyses& a, int optLevel) {
+        stats = FoldTrees(p);
+    }
+
+}
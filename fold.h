@@ -0,0 +1,31 @@
+#pragma once
+
+#include <L3.h>
+#include <passes.h>
+
+namespace L3 {
+
+  class FoldStats {
+    public:
+      int64_t folded = 0;       // operations on constants replaced by their result
+      int64_t compares = 0;     // of which compares
+      int64_t identities = 0;   // operations giving back an operand, or a constant whatever it is
+      int64_t moves = 0;        // trees left assigning a var to itself, removed
+  };
+
+  FoldStats FoldTrees(Program& p);
+
+  /*
+   * constant folding and algebraic identities on the merged trees, before the tiles see them
+   *   a tree merged into another can bring a constant to its user, the user can fold in turn
+   */
+  class FoldPass : public Pass {
+    public:
+      FoldPass () : Pass ("fold", 1, {}, 0) {}
+
+      void run(Program& p, Analyses& a, int optLevel) override;
+
+      FoldStats stats;
+  };
+
+}
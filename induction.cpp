@@ -0,0 +1,649 @@
+#include <algorithm>
+#include <map>
+#include <tuple>
+
+#include <induction.h>
+#include <report.h>
+
+namespace L3 {
+
+    /* the op an aop/sop with a constant on the right is a form of, add for addn */
+    static Op Plain(Op op) {
+        return op <= Op::s_rn && op % 2 ? static_cast<Op>(op - 1) : op;
+    }
+
+    /* an induction var of the loop being reduced, a function of the counter it is derived from */
+    class Induction {
+      public:
+        int base = 0;           // counter, 0 for a var that is none
+        int def = -1;           // the instruction writing it in the loop, the step for a counter
+        int from = 0;           // induction var its def reads, the counter itself for a counter
+        int side = 0;           // leaf of the def reading it
+        int depth = 0;          // ops from the counter
+        int key = 0;            // the same for the vars computed by the same chain from the same counter
+        bool known = true;      // the step is the constant n
+        int64_t n = 0;
+        bool growing = true;    // strictly, with the counter: invariants added and positive constants multiplied only
+        bool read = false;      // by a tree computing no induction var
+        bool address = false;   // by a load or store, as the address
+        bool reduced = false;
+        Item init;              // computed in the preheader, NONE until needed
+        Item step;
+        Item tracked;           // var stepped along with the counter
+    };
+
+    class Reduction {
+      public:
+        Reduction (Program& p, Function* f, Analyses& a, InductionStats& stats);
+
+        void reduce();
+        bool rewrite();
+
+      private:
+        void find(int l);
+        void derive(int k);
+        bool family(Item x, int k);
+        bool invariant(Item y);
+        bool escapes(int l, int v);
+        bool start(int l, int i, int64_t& n);
+        bool range(int l, int i, int64_t& lo, int64_t& hi);
+        bool near(int v, int64_t x);
+        void replace(int l, int i);
+
+        Item fresh();
+        Item replay(int l, int v, Item x);
+        Item init(int l, int v);
+        Item step(int l, int v);
+        Item through(int l, int v, Item n);
+        Node arith(Item root, Op op, Item a, Item b);
+
+        Program& p;
+        Function* f;
+        TreePool& T;
+        CFG& g;
+        LoopForest& F;
+        Liveness& L;
+        InductionStats& stats;
+
+        std::vector<int> inside;                 // defs of each var in the loop being reduced
+        std::vector<Induction> ind;              // of each var in it
+        std::vector<int> body;
+        std::vector<int> found;                  // induction vars, counters then derived ones in the order of their defs
+        std::map<std::tuple<int, int, int, int, int64_t>, int> keys;   // of the chains, by the key of the var read, op, side and invariant
+        std::map<int, Item> tracking;            // var tracking each key
+        std::vector<std::vector<Node>> pre;      // preheader trees of each loop
+        std::vector<std::vector<Node>> after;    // trees stepping the vars tracking a counter, after its step
+        std::vector<bool> removed;               // steps of the counters removed
+    };
+
+    Reduction::Reduction (Program& p, Function* f, Analyses& a, InductionStats& stats)
+      : p {p},
+        f {f},
+        T {f->trees},
+        g {a.cfg(f)},
+        F {a.loops(f)},
+        L {a.liveness(f)},
+        stats {stats},
+        inside (L.bits, 0),
+        ind (L.bits),
+        pre (F.loops.size()),
+        after (g.size),
+        removed (g.size, false) {}
+
+    void Reduction::reduce() {
+        for (int l = 0; l < (int)F.loops.size(); l++) {
+            if (!PreheaderFits(p, f, g, F, l)) {
+                continue;
+            }
+            find(l);
+
+            /* a derived var read at least two ops from its counter is tracked, the chain computing it is left to die */
+            std::vector<int> tracked;
+            for (auto v : found) {
+                auto& d = ind[v];
+                if (d.base == v || !d.read || d.depth < 2) {
+                    continue;
+                }
+                d.reduced = true;
+                auto& p = tracking[d.key];
+                if (p.type == NONE) {
+                    p = fresh();
+                    pre[l].push_back(arith(p, Op::asmt, init(l, v), Item()));
+                    after[ind[d.base].def].push_back(arith(p, Op::add, p, step(l, v)));
+                }
+                d.tracked = p;
+                tracked.push_back(v);
+            }
+            for (auto v : found) {
+                if (ind[v].base == v) {
+                    replace(l, v);
+                }
+            }
+
+            /*
+             * the chains are replayed, the defs of the tracked vars can copy them now,
+             * the trees reading them further down the block with no step in between read the tracking var itself
+             */
+            for (auto v : tracked) {
+                auto t = g.inst[ind[v].def];
+                auto leaf = T.make(ind[v].tracked, Op::leaf);
+                T.op[t] = Op::asmt;
+                T.left[t] = leaf;
+                T.right[t] = NIL;
+                stats.reduced++;
+            }
+            for (auto i : body) {
+                auto t = g.inst[i];
+                for (int k = 0; k < T.size(t); k++) {
+                    auto x = T.root[T.leaf(t, k)];
+                    if (x.type == VAR && x.getval() < (int64_t)ind.size() && ind[x.getval()].reduced && family(x, i)) {
+                        T.leaf(t, k) = T.make(ind[x.getval()].tracked, Op::leaf);
+                    }
+                }
+            }
+
+            for (auto i : body) {
+                if (L.KILL[i] >= 0) {
+                    inside[L.KILL[i]] = 0;
+                }
+            }
+            for (auto v : found) {
+                ind[v] = Induction();
+            }
+            keys.clear();
+            tracking.clear();
+        }
+    }
+
+    /* the counters of loop l, then the vars derived from them, and what reads them */
+    void Reduction::find(int l) {
+        body.clear();
+        found.clear();
+        for (auto b : F.loops[l].blocks) {
+            for (int i = g.first[b]; i <= g.last[b]; i++) {
+                if (g.inst[i] != NIL) {
+                    body.push_back(i);
+                    if (L.KILL[i] >= 0) {
+                        inside[L.KILL[i]]++;
+                    }
+                }
+            }
+        }
+
+        for (auto i : body) {
+            auto t = g.inst[i];
+            int v = L.KILL[i];
+            auto op = Plain(T.op[t]);
+            if (v < 0 || inside[v] != 1 || (op != Op::add && op != Op::sub) || removed[i]) {
+                continue;
+            }
+            if (T.op[T.left[t]] != Op::leaf || T.op[T.right[t]] != Op::leaf) {
+                continue;
+            }
+            auto x = T.root[T.left[t]];
+            auto y = T.root[T.right[t]];
+            int side = 0;
+            if (op == Op::add && x.type == NUM) {
+                std::swap(x, y);
+                side = 1;
+            }
+            if (x != Var(v) || y.type != NUM || y.getval() == 0) {
+                continue;
+            }
+            auto& c = ind[v];
+            c.base = c.from = c.key = v;
+            c.def = i;
+            c.side = side;
+            c.n = op == Op::add ? y.getval() : arithmetic(0, y.getval(), Op::sub);
+            c.init = x;
+            c.step = Num(c.n);
+            found.push_back(v);
+            stats.basic++;
+        }
+        if (found.empty()) {
+            return;
+        }
+        for (auto i : body) {
+            derive(i);
+        }
+
+        for (auto i : body) {
+            auto t = g.inst[i];
+            int v = L.KILL[i];
+            bool derived = v >= 0 && ind[v].base && ind[v].def == i;
+            for (int k = 0; k < T.size(t); k++) {
+                auto x = T.root[T.leaf(t, k)];
+                if (x.type != VAR || x.getval() >= (int64_t)ind.size() || !ind[x.getval()].base || (derived && ind[v].side == k)) {
+                    continue;
+                }
+                auto& d = ind[x.getval()];
+                d.read = true;
+                d.address |= k == 0 && (T.op[t] == Op::load || T.op[t] == Op::store);
+            }
+        }
+    }
+
+    /* instruction k writes a var derived from an induction var it reads and an invariant */
+    void Reduction::derive(int k) {
+        auto t = g.inst[k];
+        int v = L.KILL[k];
+        if (v < 0 || inside[v] != 1 || ind[v].base || T.op[t] > Op::asmt) {
+            return;
+        }
+        int n = T.size(t);
+        int side = -1;
+        for (int s = n - 1; s >= 0; s--) {
+            if (T.op[T.leaf(t, s)] != Op::leaf) {
+                return;
+            }
+            if (family(T.root[T.leaf(t, s)], k)) {
+                side = s;
+            }
+        }
+        if (side < 0) {
+            return;
+        }
+        auto y = n == 2 ? T.root[T.leaf(t, 1 - side)] : Item();
+        if (n == 2 && !invariant(y)) {
+            return;
+        }
+        auto from = T.root[T.leaf(t, side)].getval();
+        auto& x = ind[from];
+        Induction d;
+        d.base = x.base;
+        d.def = k;
+        d.from = from;
+        d.side = side;
+        d.depth = x.depth + (T.op[t] != Op::asmt);
+        d.known = x.known;
+        d.n = x.n;
+        d.growing = x.growing;
+        int64_t c = y.getval();
+        switch (Plain(T.op[t])) {
+            case Op::asmt :
+            case Op::add :
+                break;
+            case Op::sub :
+                if (side != 0) {
+                    return;
+                }
+                break;
+            case Op::mult :
+                if (y.type == NUM) {
+                    d.n = arithmetic(x.n, c, Op::mult);
+                    d.growing = d.growing && c > 0;
+                } else {
+                    d.known = d.growing = false;
+                }
+                break;
+            case Op::s_l :
+                if (side != 0 || y.type != NUM) {
+                    return;
+                }
+                d.n = arithmetic(x.n, c, Op::s_l);
+                d.growing = d.growing && (c & 63) < 63;
+                break;
+            case Op::s_r :
+                if (side != 0 || y.type != NUM || !x.known || (x.n & ((uint64_t(1) << (c & 63)) - 1))) {
+                    return;
+                }
+                d.n = arithmetic(x.n, c, Op::s_r);
+                d.growing = false;
+                break;
+            default :
+                return;
+        }
+        d.key = x.key;
+        if (T.op[t] != Op::asmt) {
+            auto& key = keys[{x.key, Plain(T.op[t]), side, y.type, y.getval()}];
+            if (!key) {
+                key = ind.size() + keys.size();
+            }
+            d.key = key;
+        }
+        ind[v] = d;
+        found.push_back(v);
+        stats.derived++;
+    }
+
+    /* x holds an induction var as a function of the counter right now: a counter, or written earlier in the block with no step in between */
+    bool Reduction::family(Item x, int k) {
+        if (x.type != VAR || x.getval() >= (int64_t)ind.size() || !ind[x.getval()].base) {
+            return false;
+        }
+        auto& d = ind[x.getval()];
+        if (d.base == x.getval()) {
+            return true;
+        }
+        int step = ind[d.base].def;
+        return g.block_of[d.def] == g.block_of[k] && d.def < k && !(d.def < step && step < k);
+    }
+
+    bool Reduction::invariant(Item y) {
+        return y.type == NUM || (y.type == VAR && y.getval() < (int64_t)inside.size() && inside[y.getval()] == 0);
+    }
+
+    /* var v is live on some edge out of loop l */
+    bool Reduction::escapes(int l, int v) {
+        for (auto b : F.loops[l].exits) {
+            for (auto s : g.succ[b]) {
+                if (!F.contains(l, s) && L.flow.IN.test(s, v)) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    /* the constant counter i holds on the way into loop l, written last in the blocks falling or jumping into one another above it */
+    bool Reduction::start(int l, int i, int64_t& n) {
+        int b = -1;
+        for (auto q : g.pred[F.loops[l].header]) {
+            if (!F.contains(l, q)) {
+                if (b >= 0) {
+                    return false;
+                }
+                b = q;
+            }
+        }
+        for (int k = 0; b >= 0 && k < g.blocks(); k++) {
+            for (int j = g.last[b]; j >= g.first[b]; j--) {
+                auto t = g.inst[j];
+                if (t == NIL || L.KILL[j] != i) {
+                    continue;
+                }
+                if (T.op[t] != Op::asmt || T.op[T.left[t]] != Op::leaf || T.root[T.left[t]].type != NUM) {
+                    return false;
+                }
+                n = T.root[T.left[t]].getval();
+                return true;
+            }
+            b = g.pred[b].size() == 1 ? g.pred[b][0] : -1;
+        }
+        return false;
+    }
+
+    /*
+     * the values counter i takes in loop l, from the constant it starts at up to the step past the constant
+     * the compare of the header keeps it within, the loop left on the other way out of the header
+     */
+    bool Reduction::range(int l, int i, int64_t& lo, int64_t& hi) {
+        int h = F.loops[l].header;
+        auto branch = g.inst[g.last[h]];
+        if (!start(l, i, lo) || branch == NIL || T.op[branch] != Op::cjmp || T.op[T.left[branch]] != Op::leaf) {
+            return false;
+        }
+        int taken = g.block_of[f->label_id_map.find(T.root[branch].getval())->second];
+        if (h + 1 >= g.blocks() || F.contains(l, taken) == F.contains(l, h + 1)) {
+            return false;
+        }
+        Node test = NIL;
+        for (int j = g.first[h]; j < g.last[h]; j++) {
+            if (g.inst[j] != NIL && L.KILL[j] >= 0 && Var(L.KILL[j]) == T.root[T.left[branch]]) {
+                test = g.inst[j];
+            }
+        }
+        if (test == NIL || (T.op[test] != Op::c_l && T.op[test] != Op::c_le)) {
+            return false;
+        }
+        if (T.op[T.left[test]] != Op::leaf || T.op[T.right[test]] != Op::leaf) {
+            return false;
+        }
+        int s = T.root[T.left[test]] == Var(i) ? 0 : 1;
+        auto n = T.root[T.leaf(test, 1 - s)];
+        if (T.root[T.leaf(test, s)] != Var(i) || n.type != NUM) {
+            return false;
+        }
+
+        /* staying in the loop keeps i below n, or above it, by one more for a strict compare */
+        bool below = (s == 0) == F.contains(l, taken);
+        bool strict = (T.op[test] == Op::c_l) == F.contains(l, taken);
+        int64_t c = ind[i].n;
+        if (below != (c > 0)) {
+            return false;
+        }
+        int64_t edge;
+        if (__builtin_add_overflow(n.getval(), strict ? (below ? -1 : 1) : 0, &edge) || __builtin_add_overflow(edge, c, &edge)) {
+            return false;
+        }
+        hi = lo;
+        if (below) {
+            hi = std::max(hi, edge);
+        } else {
+            lo = std::min(lo, edge);
+        }
+        return true;
+    }
+
+    /*
+     * derived var v holds a value within 2^48 of 0 when its counter is x, its invariant vars taken as 0,
+     * so a var computed by the same chain and addressing memory cannot wrap around, an address being below 2^47
+     */
+    bool Reduction::near(int v, int64_t x) {
+        const int64_t far = int64_t(1) << 48;
+        std::vector<int> chain;
+        for (int u = v; ind[u].base != u; u = ind[u].from) {
+            chain.push_back(u);
+        }
+        for (int k = chain.size() - 1; k >= 0; k--) {
+            auto& d = ind[chain[k]];
+            auto t = g.inst[d.def];
+            auto y = T.size(t) == 2 ? T.root[T.leaf(t, 1 - d.side)] : Num(0);
+            int64_t c = y.type == NUM ? y.getval() : 0;
+            bool wraps = false;
+            switch (Plain(T.op[t])) {
+                case Op::asmt :
+                    break;
+                case Op::add :
+                    wraps = __builtin_add_overflow(x, c, &x);
+                    break;
+                case Op::sub :
+                    wraps = __builtin_sub_overflow(x, c, &x);
+                    break;
+                case Op::mult :
+                    wraps = y.type != NUM || __builtin_mul_overflow(x, c, &x);
+                    break;
+                case Op::s_l :
+                    wraps = (c & 63) >= 62 || __builtin_mul_overflow(x, int64_t(1) << (c & 63), &x);
+                    break;
+                default :
+                    return false;
+            }
+            if (wraps || x > far || x < -far) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /*
+     * counter i read only by its step, by compares with constants and by the chains of tracked vars compares a tracked var
+     * addressing memory instead, the constant taken through the chain, and loses its step,
+     * when i starts at a constant and the compare of the header bounds it, so the chain keeps every value i is compared at
+     * and every constant near 0, as the tracked var then does not wrap around where i does not
+     */
+    void Reduction::replace(int l, int i) {
+        int j = 0;
+        for (auto v : found) {
+            if (ind[v].base == i && ind[v].reduced && ind[v].growing && ind[v].address) {
+                j = v;
+                break;
+            }
+        }
+        if (!j || escapes(l, i)) {
+            return;
+        }
+
+        /* the derived vars still computed from what they read, the later ones first */
+        std::vector<bool> reading (ind.size(), false);
+        for (int k = found.size() - 1; k >= 0; k--) {
+            int v = found[k];
+            auto& d = ind[v];
+            if (d.base == i && d.base != v && !d.reduced && (reading[v] || d.read || escapes(l, v))) {
+                reading[d.from] = true;
+            }
+        }
+        if (reading[i]) {
+            return;
+        }
+
+        std::vector<std::pair<Node, int>> tests;
+        for (auto k : body) {
+            auto t = g.inst[k];
+            int v = L.KILL[k];
+            if (k == ind[i].def || (v >= 0 && ind[v].base == i && ind[v].def == k && ind[v].from == i)) {
+                continue;
+            }
+            for (int s = 0; s < T.size(t); s++) {
+                if (T.root[T.leaf(t, s)] != Var(i)) {
+                    continue;
+                }
+                bool compare = T.op[t] >= Op::c_l && T.op[t] <= Op::c_ge && T.size(t) == 2 && T.op[T.leaf(t, 1 - s)] == Op::leaf;
+                if (!compare || !invariant(T.root[T.leaf(t, 1 - s)])) {
+                    return;
+                }
+                tests.push_back({t, s});
+            }
+        }
+        if (tests.empty()) {
+            return;
+        }
+        int64_t lo;
+        int64_t hi;
+        if (!range(l, i, lo, hi)) {
+            return;
+        }
+        for (auto [t, s] : tests) {
+            auto n = T.root[T.leaf(t, 1 - s)];
+            if (n.type != NUM) {
+                return;
+            }
+            lo = std::min(lo, n.getval());
+            hi = std::max(hi, n.getval());
+        }
+        if (!near(j, lo) || !near(j, hi)) {
+            return;
+        }
+        for (auto [t, s] : tests) {
+            auto tracked = T.make(ind[j].tracked, Op::leaf);
+            auto bound = T.make(through(l, j, T.root[T.leaf(t, 1 - s)]), Op::leaf);
+            T.leaf(t, s) = tracked;
+            T.leaf(t, 1 - s) = bound;
+            stats.tests++;
+        }
+        removed[ind[i].def] = true;
+        stats.removed++;
+    }
+
+    Item Reduction::fresh() {
+        return Var(++f->var_count);
+    }
+
+    Node Reduction::arith(Item root, Op op, Item a, Item b) {
+        if (op == Op::asmt) {
+            return T.make(root, op, T.make(a, Op::leaf));
+        }
+        return T.make(root, b.type == NUM ? static_cast<Op>(Plain(op) + 1) : op, T.make(a, Op::leaf), T.make(b, Op::leaf));
+    }
+
+    /* the def of derived var v again in the preheader of loop l, reading x for its induction var */
+    Item Reduction::replay(int l, int v, Item x) {
+        auto t = g.inst[ind[v].def];
+        if (T.op[t] == Op::asmt) {
+            return x;
+        }
+        auto e = fresh();
+        auto a = T.root[T.left[t]];
+        auto b = T.root[T.right[t]];
+        (ind[v].side ? b : a) = x;
+        pre[l].push_back(T.make(e, T.op[t], T.make(a, Op::leaf), T.make(b, Op::leaf)));
+        return e;
+    }
+
+    Item Reduction::init(int l, int v) {
+        auto& d = ind[v];
+        if (d.init.type == NONE) {
+            d.init = replay(l, v, init(l, d.from));
+        }
+        return d.init;
+    }
+
+    Item Reduction::step(int l, int v) {
+        auto& d = ind[v];
+        if (d.step.type != NONE) {
+            return d.step;
+        }
+        if (d.known) {
+            return d.step = Num(d.n);
+        }
+        auto s = step(l, d.from);
+        auto t = g.inst[d.def];
+        auto op = Plain(T.op[t]);
+        if (op == Op::mult || op == Op::s_l) {
+            auto y = T.root[T.leaf(t, 1 - d.side)];
+            if (op == Op::mult && s == Num(1)) {
+                return d.step = y;
+            }
+            d.step = fresh();
+            pre[l].push_back(arith(d.step, op, s, y));
+            return d.step;
+        }
+        return d.step = s;
+    }
+
+    /* invariant n taken through the chain computing derived var v from its counter */
+    Item Reduction::through(int l, int v, Item n) {
+        if (ind[v].base == v) {
+            return n;
+        }
+        return replay(l, v, through(l, ind[v].from, n));
+    }
+
+    /* the steps of the tracked vars after the steps of their counters, the preheaders ahead of the loops, true when some var is tracked */
+    bool Reduction::rewrite() {
+        bool any = false;
+        for (auto& trees : pre) {
+            any |= !trees.empty();
+        }
+        if (!any) {
+            return false;
+        }
+        std::vector<Context*> contexts;
+        for (auto c : f->contexts) {
+            std::vector<Node> trees;
+            for (auto t : c->trees) {
+                int i = T.id_in_func[t];
+                if (!removed[i]) {
+                    trees.push_back(t);
+                }
+                trees.insert(trees.end(), after[i].begin(), after[i].end());
+            }
+            c->trees = trees;
+            if (!c->trees.empty()) {
+                contexts.push_back(c);
+            }
+        }
+        f->contexts = contexts;
+        InsertPreheaders(p, f, g, F, pre);
+        return true;
+    }
+
+    InductionStats ReduceInductions(Program& p, Analyses& a) {
+        InductionStats stats;
+        for (auto f : p.functions) {
+            report.begin_function(f->name);
+            if (a.cfg(f).blocks() > 0) {
+                Reduction r (p, f, a, stats);
+                r.reduce();
+                r.rewrite();
+            }
+            report.end_function();
+        }
+        return stats;
+    }
+
+    void InductionPass::run(Program& p, Analyses& a, int optLevel) {
+        stats = ReduceInductions(p, a);
+    }
+
+}
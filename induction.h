@@ -0,0 +1,40 @@
+#pragma once
+
+#include <L3.h>
+#include <passes.h>
+
+namespace L3 {
+
+  class InductionStats {
+    public:
+      int64_t basic = 0;       // vars a loop only steps by a constant
+      int64_t derived = 0;     // vars a loop computes from one of them and invariants, affinely
+      int64_t reduced = 0;     // of which now read from a var stepped along with the counter
+      int64_t tests = 0;       // compares of a counter with an invariant, now made on a reduced var
+      int64_t removed = 0;     // counters left stepping nothing but themselves, removed
+  };
+
+  InductionStats ReduceInductions(Program& p, Analyses& a);
+
+  /*
+   * strength reduction of induction vars, ahead of merging
+   *   a basic induction var has a single def in a loop adding a constant to itself,
+   *   a derived one a single def adding, subtracting or multiplying an invariant to a basic or derived one,
+   *   or shifting it by a constant, read in the block it is written in with no step of the counter in between
+   *   a derived var at least two ops from its counter and read by a tree computing no induction var gets
+   *   a var of its own, computed in the preheader and stepped right after the counter, its def and the trees reading it
+   *   further down the block with no step in between read that var instead, so the chain computing it is left dead
+   *   a counter then read only by its step and by compares with constants, starting at a constant and kept within one
+   *   by the compare of the loop header, is replaced in the compares by a reduced var addressing memory, growing with it,
+   *   and removed, when the chain computing that var keeps the values the counter is compared at within 2^48 of 0
+   */
+  class InductionPass : public Pass {
+    public:
+      InductionPass () : Pass ("iv", 2, {}, 0) {}
+
+      void run(Program& p, Analyses& a, int optLevel) override;
+
+      InductionStats stats;
+  };
+
+}
@@ -0,0 +1,234 @@
+#include <map>
+
+#include <inline.h>
+#include <report.h>
+
+namespace L3 {
+
+    class Inliner {
+      public:
+        Inliner (Program& p, int budget, InlineStats& stats);
+
+        void run();
+
+      private:
+        void visit(int k);
+        void expand(int k);
+        int callee(Node t);
+        bool worth(Node t, int g);
+        void splice(Node t, Function* g, std::vector<Context*>& contexts);
+        Item rename(Item x);
+
+        Program& p;
+        int budget;
+        InlineStats& stats;
+
+        std::vector<int> functions;      // of each callee name, -1 for a runtime function
+        std::vector<int> state;          // of each function, 0 not visited, 1 on the way, 2 done
+        std::vector<int> sizes;          // trees of each function, its labels aside
+        std::vector<bool> copyable;      // no tree of the function holds a label as a value
+
+        Function* f;                     // being inlined into
+        std::vector<Item> vars;          // of the callee being copied in the caller, NONE until read
+        std::map<int64_t, int64_t> labels;
+    };
+
+    Inliner::Inliner (Program& p, int budget, InlineStats& stats)
+      : p {p},
+        budget {budget},
+        stats {stats},
+        functions (p.fun_names.size(), -1),
+        state (p.functions.size(), 0),
+        sizes (p.functions.size(), 0),
+        copyable (p.functions.size(), true) {
+        for (int k = 0; k < (int)p.functions.size(); k++) {
+            auto g = p.functions[k];
+            auto it = p.fun_ids.find(g->name);
+            if (it != p.fun_ids.end()) {
+                functions[it->second] = k;
+            }
+            for (auto c : g->contexts) {
+                for (auto t : c->trees) {
+                    sizes[k] += g->trees.op[t] != Op::label;
+                    copyable[k] = copyable[k] && !HoldsLabel(g->trees, t);
+                }
+            }
+        }
+    }
+
+    /* the callees first, so a caller is weighed with the calls it got inlined */
+    void Inliner::run() {
+        for (int k = 0; k < (int)p.functions.size(); k++) {
+            if (state[k] == 0) {
+                visit(k);
+            }
+        }
+    }
+
+    void Inliner::visit(int k) {
+        state[k] = 1;
+        auto g = p.functions[k];
+        for (auto c : g->contexts) {
+            for (auto t : c->trees) {
+                if (g->trees.op[t] != Op::call) {
+                    continue;
+                }
+                f = g;
+                int h = callee(t);
+                if (h >= 0 && state[h] == 0) {
+                    visit(h);
+                }
+            }
+        }
+        state[k] = 2;
+        report.begin_function(g->name);
+        expand(k);
+        report.end_function();
+    }
+
+    /* the calls of function k worth inlining replaced by the bodies of their callees */
+    void Inliner::expand(int k) {
+        f = p.functions[k];
+        auto& T = f->trees;
+        bool any = false;
+        for (auto c : f->contexts) {
+            for (auto t : c->trees) {
+                if (T.op[t] == Op::call) {
+                    int g = callee(t);
+                    stats.calls += g >= 0;
+                    any |= g >= 0 && g != k && worth(t, g);
+                }
+            }
+        }
+        if (!any) {
+            return;
+        }
+
+        int grown = 0;
+        std::vector<Context*> contexts;
+        for (auto c : f->contexts) {
+            std::vector<Node> run;
+            for (auto t : c->trees) {
+                int g = T.op[t] == Op::call ? callee(t) : -1;
+                if (g < 0 || g == k || !worth(t, g) || grown + sizes[g] > 16 * budget) {
+                    run.push_back(t);
+                    continue;
+                }
+                Place(p, f, contexts, run);
+                run.clear();
+                splice(t, p.functions[g], contexts);
+                grown += sizes[g];
+                stats.inlined++;
+            }
+            Place(p, f, contexts, run);
+        }
+        f->contexts = contexts;
+        sizes[k] += grown;
+        Renumber(f);
+    }
+
+    /* function called by call tree t of the function being inlined into, -1 for a runtime function or a var */
+    int Inliner::callee(Node t) {
+        auto x = f->trees.root[f->trees.back(t)];
+        return x.type == FUN ? functions[x.getval()] : -1;
+    }
+
+    /* the callee takes at most budget trees more than the call */
+    bool Inliner::worth(Node t, int g) {
+        auto& T = f->trees;
+        int n = T.size(t) - 2;
+        if (!copyable[g] || (int)p.functions[g]->args.size() != n) {
+            return false;
+        }
+        int call = n + 4;
+        for (int i = 0; i < n; i++) {
+            call += T.root[T.leaf(t, i)].type == NUM;
+        }
+        return sizes[g] <= call + budget;
+    }
+
+    /*
+     * the args assigned to fresh vars, then the body of g with its vars and labels renamed,
+     * its returns writing the var of the call and jumping to the return label of the call, which ends the copy
+     */
+    void Inliner::splice(Node t, Function* g, std::vector<Context*>& contexts) {
+        auto& T = f->trees;
+        auto& G = g->trees;
+        vars.assign(g->var_count + 1, Item());
+        labels.clear();
+        auto dst = T.root[t];
+        auto back = T.root[T.leaf(t, T.size(t) - 2)];
+
+        std::vector<Node> trees;
+        for (int i = 0; i < (int)g->args.size(); i++) {
+            auto x = T.root[T.leaf(t, i)];
+            trees.push_back(T.make(rename(g->args[i]), Op::asmt, T.make(x, Op::leaf)));
+        }
+        Place(p, f, contexts, trees);
+
+        Node last = NIL;
+        for (auto c : g->contexts) {
+            if (!c->trees.empty()) {
+                last = c->trees.back();
+            }
+        }
+        auto renamed = [&](Item x) {
+            return rename(x);
+        };
+        bool jumps = false;
+        for (auto c : g->contexts) {
+            trees.clear();
+            for (auto u : c->trees) {
+                if (G.op[u] != Op::ret) {
+                    trees.push_back(CopyTree(G, u, T, renamed));
+                    stats.trees++;
+                    continue;
+                }
+                if (G.left[u] != NIL && dst.type == VAR) {
+                    trees.push_back(T.make(dst, Op::asmt, CopyTree(G, G.left[u], T, renamed)));
+                }
+                if (u != last) {
+                    trees.push_back(T.make(back, Op::br));
+                    jumps = true;
+                    stats.returns++;
+                }
+            }
+            Place(p, f, contexts, trees);
+        }
+        if (jumps) {
+            Place(p, f, contexts, {T.make(back, Op::label)});
+        }
+    }
+
+    /* a var or label of the callee as the caller knows it, fresh the first time */
+    Item Inliner::rename(Item x) {
+        if (x.type == VAR) {
+            auto& v = vars[x.getval()];
+            if (v.type == NONE) {
+                v = Var(++f->var_count);
+            }
+            return v;
+        }
+        if (x.type == LABEL) {
+            auto it = labels.find(x.getval());
+            if (it == labels.end()) {
+                it = labels.insert({x.getval(), ++p.global_label_count}).first;
+            }
+            return Label(it->second);
+        }
+        return x;
+    }
+
+    InlineStats InlineCalls(Program& p, Analyses& a, int budget) {
+        InlineStats stats;
+        Inliner inliner (p, budget, stats);
+        inliner.run();
+        return stats;
+    }
+
+    /* a callee can take 16 trees more than its call at -O2, twice as many per level above */
+    void InlinePass::run(Program& p, Analyses& a, int optLevel) {
+        stats = InlineCalls(p, a, 4 << optLevel);
+    }
+
+}
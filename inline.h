@@ -0,0 +1,36 @@
+#pragma once
+
+#include <L3.h>
+#include <passes.h>
+
+namespace L3 {
+
+  class InlineStats {
+    public:
+      int64_t calls = 0;      // calls to functions of the program
+      int64_t inlined = 0;    // of which replaced by the body of the callee
+      int64_t trees = 0;      // copied from the callees
+      int64_t returns = 0;    // returns of the copies turned into jumps to the return label
+  };
+
+  InlineStats InlineCalls(Program& p, Analyses& a, int budget);
+
+  /*
+   * inlining of calls to the functions of the program, ahead of every other pass
+   *   the callees are inlined into before their callers, so a caller weighs each callee with the calls it got inlined,
+   *   a call is inlined when the trees of the callee, its labels aside, are at most budget more than
+   *   the instructions the call takes: the args into registers, the return label, the call and the result,
+   *   one more for each constant arg, and while the caller has grown by at most 16 budgets
+   *   the copy reads fresh vars assigned the args, has fresh labels and jumps to the return label of the call
+   *   on a return, having written its value to the var of the call
+   */
+  class InlinePass : public Pass {
+    public:
+      InlinePass () : Pass ("inline", 2, {}, 0) {}
+
+      void run(Program& p, Analyses& a, int optLevel) override;
+
+      InlineStats stats;
+  };
+
+}
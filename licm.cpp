@@ -0,0 +1,361 @@
+#include <algorithm>
+
+#include <licm.h>
+#include <report.h>
+
+namespace L3 {
+
+    /* where a var points, an offset into the memory another var got from allocate, root 0 when not known */
+    class Address {
+      public:
+        int root = 0;
+        bool exact = false;   // the offset is known
+        int64_t offset = 0;
+    };
+
+    /* two accesses can touch the same word unless they are into different allocations or whole words apart */
+    static bool MayAlias(const Address& a, const Address& b) {
+        if (a.root == 0 || b.root == 0) {
+            return true;
+        }
+        if (a.root != b.root) {
+            return false;
+        }
+        return !a.exact || !b.exact || (a.offset - b.offset < 8 && b.offset - a.offset < 8);
+    }
+
+    class Licm {
+      public:
+        Licm (Program& p, Function* f, Analyses& a, LicmStats& stats);
+
+        bool hoist();
+        void rewrite();
+
+      private:
+        bool invariant(int i, int l);
+        void keep(int l);
+        bool safe(int i, int l);
+        Address address(Item it);
+        Address form(int v);
+
+        Program& p;
+        Function* f;
+        TreePool& T;
+        CFG& g;
+        DomTree& D;
+        LoopForest& F;
+        Liveness& L;
+        LicmStats& stats;
+
+        std::vector<std::vector<int>> defs;   // instructions writing each var
+        std::vector<Address> forms;           // of each var
+        std::vector<int> found;               // of the form of each var, 0 not yet, 1 on the way, 2 done
+        std::vector<int> target;              // loop each instruction leaves for its preheader, -1 for none
+        std::vector<std::vector<int>> moved;  // instructions leaving each loop
+        std::vector<int> inside;              // defs of each var left in the loop being hoisted out of
+        std::vector<bool> read;               // vars read by the trees leaving it
+        std::vector<int> accesses;            // loads and stores of the function
+        std::vector<int> stores;              // of the loop being hoisted out of
+        bool clobbered;                       // a call in that loop can write memory
+    };
+
+    Licm::Licm (Program& p, Function* f, Analyses& a, LicmStats& stats)
+      : p {p},
+        f {f},
+        T {f->trees},
+        g {a.cfg(f)},
+        D {a.dominators(f)},
+        F {a.loops(f)},
+        L {a.liveness(f)},
+        stats {stats},
+        defs (L.bits),
+        forms (L.bits),
+        found (L.bits, 0),
+        target (g.size, -1),
+        moved (F.loops.size()),
+        inside (L.bits, 0),
+        read (L.bits, false) {
+        for (int i = 0; i < g.size; i++) {
+            if (g.inst[i] == NIL) {
+                continue;
+            }
+            if (L.KILL[i] >= 0) {
+                defs[L.KILL[i]].push_back(i);
+            }
+            if (T.op[g.inst[i]] == Op::load || T.op[g.inst[i]] == Op::store) {
+                accesses.push_back(i);
+            }
+        }
+    }
+
+    /* outer loops first, so a tree leaves every loop it is invariant in at once, true when some tree does */
+    bool Licm::hoist() {
+        bool any = false;
+        for (int l = 0; l < (int)F.loops.size(); l++) {
+            auto& loop = F.loops[l];
+            stats.loops++;
+            stats.nested += loop.depth > 1;
+            if (!PreheaderFits(p, f, g, F, l)) {
+                continue;
+            }
+            std::vector<int> body;
+            stores.clear();
+            clobbered = false;
+            for (auto b : loop.blocks) {
+                for (int i = g.first[b]; i <= g.last[b]; i++) {
+                    auto t = g.inst[i];
+                    if (t == NIL) {
+                        continue;
+                    }
+                    body.push_back(i);
+                    if (target[i] < 0 && L.KILL[i] >= 0) {
+                        inside[L.KILL[i]]++;
+                    }
+                    if (T.op[t] == Op::store) {
+                        stores.push_back(i);
+                    } else if (T.op[t] == Op::call) {
+                        auto callee = T.root[T.back(t)];
+                        clobbered |= callee.type != FUN || p.fun_names[callee.getval()][0] == '@';
+                    }
+                }
+            }
+            for (bool changed = true; changed; ) {
+                changed = false;
+                for (auto i : body) {
+                    if (target[i] < 0 && invariant(i, l)) {
+                        target[i] = l;
+                        moved[l].push_back(i);
+                        inside[L.KILL[i]]--;
+                        changed = true;
+                    }
+                }
+            }
+            keep(l);
+            for (auto i : body) {
+                if (target[i] < 0 && L.KILL[i] >= 0) {
+                    inside[L.KILL[i]]--;
+                }
+            }
+            any |= !moved[l].empty();
+        }
+        return any;
+    }
+
+    /*
+     * a var plus a constant stays in the loop unless a tree leaving it reads the var, the tiles fold it into the address
+     * of a load or store for free; the trees leaving come after the trees they read
+     */
+    void Licm::keep(int l) {
+        std::vector<int> kept;
+        for (int k = moved[l].size() - 1; k >= 0; k--) {
+            int i = moved[l][k];
+            auto t = g.inst[i];
+            auto o = T.op[t];
+            bool offset = (o == Op::add || o == Op::addn || o == Op::sub || o == Op::subn)
+                && (T.root[T.left[t]].type == NUM || T.root[T.right[t]].type == NUM);
+            if (offset && !read[L.KILL[i]]) {
+                target[i] = -1;
+                inside[L.KILL[i]]++;
+                continue;
+            }
+            kept.push_back(i);
+            for (int j = 0; j < T.size(t); j++) {
+                auto x = T.root[T.leaf(t, j)];
+                if (x.type == VAR) {
+                    read[x.getval()] = true;
+                }
+            }
+        }
+        for (auto i : kept) {
+            for (int j = 0; j < T.size(g.inst[i]); j++) {
+                auto x = T.root[T.leaf(g.inst[i], j)];
+                if (x.type == VAR) {
+                    read[x.getval()] = false;
+                }
+            }
+        }
+        moved[l].assign(kept.rbegin(), kept.rend());
+    }
+
+    /*
+     * instruction i of loop l computes the same value on every iteration and can run once ahead of the loop:
+     * its operands are written outside the loop or by trees leaving it, it writes the only def of its var left in the loop,
+     * and the var is not live into the header, so no path out of the loop reads the var without going through the tree
+     */
+    bool Licm::invariant(int i, int l) {
+        auto t = g.inst[i];
+        int v = L.KILL[i];
+        if (v < 0 || !(T.op[t] <= Op::asmt || T.op[t] == Op::load)) {
+            return false;
+        }
+        for (int k = 0; k < T.size(t); k++) {
+            auto leaf = T.leaf(t, k);
+            if (T.op[leaf] != Op::leaf) {
+                return false;
+            }
+            if (T.root[leaf].type == VAR && inside[T.root[leaf].getval()] > 0) {
+                return false;
+            }
+        }
+        if (inside[v] != 1 || L.flow.IN.test(F.loops[l].header, v)) {
+            return false;
+        }
+        return T.op[t] != Op::load || safe(i, l);
+    }
+
+    /*
+     * a load reads the same word on every iteration when nothing in the loop can write it,
+     * and it can run ahead of the loop when every iteration and every way out of the loop go through it,
+     * or the word was accessed before the loop
+     */
+    bool Licm::safe(int i, int l) {
+        auto& loop = F.loops[l];
+        if (clobbered) {
+            return false;
+        }
+        auto a = address(T.root[T.left[g.inst[i]]]);
+        for (auto j : stores) {
+            if (MayAlias(a, address(T.root[T.left[g.inst[j]]]))) {
+                return false;
+            }
+        }
+        bool reached = true;
+        for (auto b : loop.blocks) {
+            bool leaves = g.succ[b].empty() || std::find(loop.exits.begin(), loop.exits.end(), b) != loop.exits.end();
+            bool latch = std::find(loop.latches.begin(), loop.latches.end(), b) != loop.latches.end();
+            if (leaves || latch) {
+                reached = reached && D.dominates(g.block_of[i], b);
+            }
+        }
+        if (reached) {
+            return true;
+        }
+        if (a.root == 0 || !a.exact) {
+            return false;
+        }
+        for (auto j : accesses) {
+            auto b = address(T.root[T.left[g.inst[j]]]);
+            if (b.root == a.root && b.exact && b.offset == a.offset && D.dominates(g.block_of[j], loop.header)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    Address Licm::address(Item it) {
+        if (it.type != VAR) {
+            return Address();
+        }
+        int v = it.getval();
+        if (found[v] == 0) {
+            found[v] = 1;
+            forms[v] = form(v);
+            found[v] = 2;
+        }
+        return found[v] == 2 ? forms[v] : Address();
+    }
+
+    /* what the only tree writing a var makes it point to */
+    Address Licm::form(int v) {
+        Address a;
+        if (defs[v].size() != 1) {
+            return a;
+        }
+        auto t = g.inst[defs[v][0]];
+        if (T.op[t] == Op::call) {
+            auto callee = T.root[T.back(t)];
+            if (callee.type == FUN && p.fun_names[callee.getval()] == "allocate") {
+                a.root = v;
+                a.exact = true;
+            }
+            return a;
+        }
+        if (T.size(t) == 0 || T.op[T.left[t]] != Op::leaf || (T.right[t] != NIL && T.op[T.right[t]] != Op::leaf)) {
+            return a;
+        }
+        auto x = T.root[T.left[t]];
+        auto y = T.right[t] != NIL ? T.root[T.right[t]] : Item();
+        switch (T.op[t]) {
+            case Op::asmt :
+                return address(x);
+            case Op::add :
+            case Op::addn :
+                if (y.type == NUM || x.type == NUM) {
+                    a = address(y.type == NUM ? x : y);
+                    a.offset += (y.type == NUM ? y : x).getval();
+                    return a;
+                } else {
+                    auto b = address(x);
+                    auto c = address(y);
+                    if ((b.root == 0) != (c.root == 0)) {
+                        a.root = b.root + c.root;
+                    }
+                    return a;
+                }
+            case Op::sub :
+            case Op::subn :
+                if (y.type == NUM) {
+                    a = address(x);
+                    a.offset -= y.getval();
+                }
+                return a;
+            default :
+                return a;
+        }
+    }
+
+    /* the trees leaving each loop go to its preheader in dominator order, so each comes after the trees it reads */
+    void Licm::rewrite() {
+        std::vector<int> rank (g.blocks(), 0);
+        for (int k = 0; k < (int)D.preorder.size(); k++) {
+            rank[D.preorder[k]] = k;
+        }
+        std::vector<std::vector<Node>> trees (F.loops.size());
+        for (int l = 0; l < (int)F.loops.size(); l++) {
+            std::sort(moved[l].begin(), moved[l].end(), [&](int i, int j) {
+                return std::make_pair(rank[g.block_of[i]], i) < std::make_pair(rank[g.block_of[j]], j);
+            });
+            for (auto i : moved[l]) {
+                trees[l].push_back(g.inst[i]);
+                stats.hoisted++;
+                stats.loads += T.op[g.inst[i]] == Op::load;
+            }
+        }
+
+        std::vector<Context*> contexts;
+        for (auto c : f->contexts) {
+            int k = 0;
+            for (auto t : c->trees) {
+                if (target[T.id_in_func[t]] < 0) {
+                    c->trees[k++] = t;
+                }
+            }
+            c->trees.resize(k);
+            if (!c->trees.empty()) {
+                contexts.push_back(c);
+            }
+        }
+        f->contexts = contexts;
+        stats.preheaders += InsertPreheaders(p, f, g, F, trees);
+    }
+
+    LicmStats HoistInvariants(Program& p, Analyses& a) {
+        LicmStats stats;
+        for (auto f : p.functions) {
+            report.begin_function(f->name);
+            if (a.cfg(f).blocks() > 0) {
+                Licm m (p, f, a, stats);
+                if (m.hoist()) {
+                    m.rewrite();
+                }
+            }
+            report.end_function();
+        }
+        return stats;
+    }
+
+    void LicmPass::run(Program& p, Analyses& a, int optLevel) {
+        stats = HoistInvariants(p, a);
+    }
+
+}
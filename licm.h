@@ -0,0 +1,37 @@
+#pragma once
+
+#include <L3.h>
+#include <passes.h>
+
+namespace L3 {
+
+  class LicmStats {
+    public:
+      int64_t loops = 0;        // natural loops found
+      int64_t nested = 0;       // of which inside another loop
+      int64_t preheaders = 0;   // blocks added ahead of a loop header for the trees hoisted out of the loop
+      int64_t hoisted = 0;      // trees computing the same value on every iteration, moved to a preheader
+      int64_t loads = 0;        // of which loads
+  };
+
+  LicmStats HoistInvariants(Program& p, Analyses& a);
+
+  /*
+   * loop-invariant code motion, ahead of merging
+   *   a pure tree whose operands are written outside the loop or by trees hoisted already moves to the preheader
+   *   of the outermost loop it is invariant in, when it writes the only def of its var in the loop
+   *   and the var is not live into the header, so it can run ahead whether the loop body does or not
+   *   a load moves too when no call in the loop can write memory, no store in the loop can write its word,
+   *   and its address is read or written before the loop or it runs on every way out of the loop
+   *   a var plus a constant only moves for a tree moving with it, the tiles fold it into an address for free
+   */
+  class LicmPass : public Pass {
+    public:
+      LicmPass () : Pass ("licm", 2, {}, 0) {}
+
+      void run(Program& p, Analyses& a, int optLevel) override;
+
+      LicmStats stats;
+  };
+
+}
@@ -0,0 +1,243 @@
+#include <cassert>
+
+#include <liveness.h>
+
+namespace L3 {
+
+Liveness::Liveness (Function* f, CFG& cfg)
+  : f {f},
+    cfg {cfg},
+    bits {f->var_count + 1},
+    use_first (f->tree_count, 0),
+    use_end (f->tree_count, 0),
+    KILL (f->tree_count, -1),
+    flow (cfg, f->var_count + 1, BACKWARD, UNION),
+    updates {0},
+    version (cfg.blocks(), 0),
+    kill_live (f->tree_count, false),
+    dirty (cfg.blocks(), false),
+    in_region (cfg.blocks(), false),
+    scratch (4, f->var_count + 1) {
+    auto& T = f->trees;
+
+    /* generate the GEN and KILL set of each instruction */
+    for (int i = 0; i < cfg.size; i++) {
+        auto t = cfg.inst[i];
+        if (t == NIL) {
+            continue;
+        }
+        if (T.op[t] < Op::cjmp || T.op[t] == Op::call) {
+            if (T.root[t].type == VAR) {
+                KILL[i] = T.root[t].getval();
+            }
+        } else {
+            assert(T.op[t] == Op::cjmp || T.op[t] == Op::br || T.op[t] == Op::label);
+        }
+        read(i);
+    }
+
+    for (int b = 0; b < cfg.blocks(); b++) {
+        summarize(b, flow.GEN.row(b), flow.KILL.row(b));
+    }
+
+    flow.solve();
+
+    use_live.assign(uses.size(), false);
+    for (int b = 0; b < cfg.blocks(); b++) {
+        sweep(b);
+    }
+}
+
+/* collect the vars read by the tree of instruction i, below any tree grafted into it */
+void Liveness::read(int i) {
+    auto& T = f->trees;
+    auto t = cfg.inst[i];
+    use_first[i] = uses.size();
+
+    std::vector<Node> stack;
+    auto leaves = [&](Node n, int from, int to) {
+        for (int it = to - 1; it >= from; it--) {
+            stack.push_back(T.leaf(n, it));
+        }
+        while (!stack.empty()) {
+            auto l = stack.back();
+            stack.pop_back();
+            if (T.op[l] != Op::leaf) {
+                for (int k = T.size(l) - 1; k >= 0; k--) {
+                    stack.push_back(T.leaf(l, k));
+                }
+            } else if (T.root[l].type == VAR) {
+                uses.push_back(T.root[l].getval());
+            }
+        }
+    };
+    if (T.op[t] < Op::cjmp) {
+        leaves(t, 0, T.size(t));
+    } else if (T.op[t] == Op::call) {
+        leaves(t, 0, T.size(t) - 2);        // args, skipping the return label
+        leaves(t, T.size(t) - 1, T.size(t));  // callee
+    } else if (T.op[t] == Op::cjmp) {
+        leaves(t, 0, 1);
+    }
+    use_end[i] = uses.size();
+}
+
+/* GEN and KILL of block b, walking it backward */
+void Liveness::summarize(int b, uint64_t* gen, uint64_t* kill) {
+    for (int w = 0; w < flow.GEN.width; w++) {
+        gen[w] = kill[w] = 0;
+    }
+    for (int i = cfg.last[b]; i >= cfg.first[b]; i--) {
+        if (KILL[i] >= 0) {
+            gen[KILL[i] >> 6] &= ~((uint64_t)1 << (KILL[i] & 63));
+            kill[KILL[i] >> 6] |= (uint64_t)1 << (KILL[i] & 63);
+        }
+        for (int u = use_first[i]; u < use_end[i]; u++) {
+            gen[uses[u] >> 6] |= (uint64_t)1 << (uses[u] & 63);
+        }
+    }
+}
+
+/* walk block b backward from its OUT set */
+void Liveness::sweep(int b) {
+    bool changed = false;
+    scratch.assign(0, flow.OUT.row(b));
+    for (int i = cfg.last[b]; i >= cfg.first[b]; i--) {
+        for (int u = use_first[i]; u < use_end[i]; u++) {
+            bool live = scratch.test(0, uses[u]);
+            changed = changed || use_live[u] != live;
+            use_live[u] = live;
+        }
+        if (KILL[i] >= 0) {
+            bool live = scratch.test(0, KILL[i]);
+            changed = changed || kill_live[i] != live;
+            kill_live[i] = live;
+            scratch.reset(0, KILL[i]);
+        }
+        for (int u = use_first[i]; u < use_end[i]; u++) {
+            scratch.set(0, uses[u]);
+        }
+    }
+    if (changed) {
+        version[b]++;
+    }
+}
+
+bool Liveness::live_out(int i, int v) {
+    if (v == KILL[i]) {
+        return kill_live[i];
+    }
+    for (int u = use_first[i]; u < use_end[i]; u++) {
+        if (uses[u] == v) {
+            return use_live[u];
+        }
+    }
+    assert(0);
+    return true;
+}
+
+void Liveness::remove(int i) {
+    KILL[i] = -1;
+    use_end[i] = use_first[i];
+    version[cfg.block_of[i]]++;
+    touch(cfg.block_of[i]);
+}
+
+void Liveness::reread(int i) {
+    read(i);
+    use_live.resize(uses.size(), false);
+    version[cfg.block_of[i]]++;
+    touch(cfg.block_of[i]);
+}
+
+void Liveness::touch(int b) {
+    if (!dirty[b]) {
+        dirty[b] = true;
+        dirty_blocks.push_back(b);
+    }
+}
+
+/*
+ * a var changes its liveness only where a block stopped reading it, or stopped writing it while it is live out
+ * such vars are reset in the blocks reachable backward from there through their live range and solved again
+ * from those blocks, the other vars and blocks keep their solution since liveness is solved var by var
+ */
+void Liveness::update() {
+    auto gen = scratch.row(1);
+    auto kill = scratch.row(2);
+    auto changed = scratch.row(3);
+    scratch.clear(3);
+    std::vector<int> region;
+    for (auto b : dirty_blocks) {
+        summarize(b, gen, kill);
+        auto oldGen = flow.GEN.row(b);
+        auto oldKill = flow.KILL.row(b);
+        auto out = flow.OUT.row(b);
+        bool any = false;
+        for (int w = 0; w < flow.GEN.width; w++) {
+            uint64_t d = (gen[w] ^ oldGen[w]) | ((kill[w] ^ oldKill[w]) & out[w]);
+            changed[w] |= d;
+            any = any || d != 0;
+            oldGen[w] = gen[w];
+            oldKill[w] = kill[w];
+        }
+        if (any) {
+            in_region[b] = true;
+            region.push_back(b);
+        }
+    }
+
+    if (!region.empty()) {
+        std::vector<int> words;
+        for (int w = 0; w < flow.GEN.width; w++) {
+            if (changed[w]) {
+                words.push_back(w);
+            }
+        }
+        std::vector<uint64_t> old_out;   // the words of the region blocks OUT sets before the reset
+        for (int k = 0; k < (int)region.size(); k++) {
+            int b = region[k];
+            auto in = flow.IN.row(b);
+            auto out = flow.OUT.row(b);
+            for (auto w : words) {
+                old_out.push_back(out[w]);
+                in[w] &= ~changed[w];
+                out[w] &= ~changed[w];
+            }
+            for (auto p : cfg.pred[b]) {
+                if (in_region[p]) {
+                    continue;
+                }
+                auto pout = flow.OUT.row(p);
+                for (auto w : words) {
+                    if (pout[w] & changed[w]) {
+                        in_region[p] = true;
+                        region.push_back(p);
+                        break;
+                    }
+                }
+            }
+        }
+        flow.update(region, changed);
+        updates += flow.visits;
+        for (int k = 0; k < (int)region.size(); k++) {
+            int b = region[k];
+            in_region[b] = false;
+            auto out = flow.OUT.row(b);
+            for (int x = 0; x < (int)words.size(); x++) {
+                if (out[words[x]] != old_out[k * words.size() + x]) {
+                    touch(b);
+                    break;
+                }
+            }
+        }
+    }
+
+    for (auto b : dirty_blocks) {
+        sweep(b);
+        dirty[b] = false;
+    }
+    dirty_blocks.clear();
+}
+
+}
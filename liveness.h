@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+
+#include <L3.h>
+#include <cfg.h>
+#include <dataflow.h>
+
+namespace L3 {
+
+  /*
+   * live vars of a function
+   *   solved on the blocks of the CFG, then swept back through each block once to record,
+   *   for every var an instruction reads or writes, whether it is live right after it
+   *   instructions can be removed or rewritten afterwards, update() then re-solves only the vars
+   *   whose liveness can change, in the blocks they are live in
+   */
+  class Liveness {
+    public:
+      Liveness (Function* f, CFG& cfg);
+
+      bool live_out(int i, int v);    // is var v, read or written by instruction i, live right after it
+
+      void remove(int i);             // instruction i is deleted
+      void reread(int i);             // the tree of instruction i changed its leaves
+      void update();
+
+      Function* f;
+      CFG& cfg;
+      int bits;                       // vars are encoded from 1
+      std::vector<int> uses;          // vars read by instruction i are uses[use_first[i] .. use_end[i])
+      std::vector<int> use_first;
+      std::vector<int> use_end;
+      std::vector<int> KILL;          // var written by each instruction, -1 for none
+      Dataflow flow;
+
+      int64_t updates;                // block transfers evaluated by update()
+      std::vector<int> version;       // of each block, bumped when one of its instructions or live_out answers changed
+
+    private:
+      void read(int i);
+      void summarize(int b, uint64_t* gen, uint64_t* kill);
+      void sweep(int b);
+      void touch(int b);
+
+      std::vector<bool> kill_live;    // per instruction
+      std::vector<bool> use_live;     // per entry of uses
+      std::vector<bool> dirty;        // blocks with a removed or rewritten instruction
+      std::vector<int> dirty_blocks;
+      std::vector<bool> in_region;    // blocks reset by the running update()
+      BitMatrix scratch;              // live set of a sweep, new GEN and KILL of a block, vars to re-solve
+  };
+
+}
@@ -0,0 +1,180 @@
+#include <algorithm>
+
+#include <loops.h>
+
+namespace L3 {
+
+LoopForest::LoopForest (DomTree& D)
+  : D {D},
+    loop_of (D.g.blocks(), -1) {
+    auto& g = D.g;
+    int n = g.blocks();
+
+    /* back edges, by header */
+    std::vector<int> index (n, -1);
+    std::vector<Loop> found;
+    for (auto b : D.preorder) {
+        for (auto h : g.succ[b]) {
+            if (!D.dominates(h, b)) {
+                continue;
+            }
+            if (index[h] < 0) {
+                index[h] = found.size();
+                found.push_back(Loop());
+                found.back().header = h;
+            }
+            found[index[h]].latches.push_back(b);
+        }
+    }
+
+    /* the body of each loop, back from its latches to the header */
+    std::vector<int> mark (n, -1);
+    std::vector<int> todo;
+    for (int l = 0; l < (int)found.size(); l++) {
+        auto& L = found[l];
+        mark[L.header] = l;
+        L.blocks.push_back(L.header);
+        for (auto b : L.latches) {
+            if (mark[b] != l) {
+                mark[b] = l;
+                L.blocks.push_back(b);
+                todo.push_back(b);
+            }
+        }
+        while (!todo.empty()) {
+            int b = todo.back();
+            todo.pop_back();
+            for (auto p : g.pred[b]) {
+                if (mark[p] != l && D.reachable(p)) {
+                    mark[p] = l;
+                    L.blocks.push_back(p);
+                    todo.push_back(p);
+                }
+            }
+        }
+        std::sort(L.blocks.begin(), L.blocks.end());
+        for (auto b : L.blocks) {
+            for (auto s : g.succ[b]) {
+                if (mark[s] != l) {
+                    L.exits.push_back(b);
+                    break;
+                }
+            }
+        }
+    }
+
+    /* a loop contains the loops of the headers it contains, which are smaller */
+    std::vector<int> order (found.size());
+    for (int l = 0; l < (int)found.size(); l++) {
+        order[l] = l;
+    }
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+        return std::make_pair(-(int)found[a].blocks.size(), a) < std::make_pair(-(int)found[b].blocks.size(), b);
+    });
+    for (int l = 0; l < (int)found.size(); l++) {
+        loops.push_back(std::move(found[order[l]]));
+        auto& L = loops[l];
+        L.parent = loop_of[L.header];
+        L.depth = L.parent < 0 ? 1 : loops[L.parent].depth + 1;
+        for (auto b : L.blocks) {
+            loop_of[b] = l;
+        }
+    }
+}
+
+bool LoopForest::contains(int l, int b) const {
+    int k = loop_of[b];
+    while (k > l) {
+        k = loops[k].parent;
+    }
+    return k == l;
+}
+
+/* the block does not end in a jump always taken, a return or a call never returning */
+static bool Falls(Program& p, CFG& g, TreePool& T, int b) {
+    auto t = g.inst[g.last[b]];
+    if (t == NIL) {
+        return true;
+    }
+    if (T.op[t] == Op::br || T.op[t] == Op::ret) {
+        return false;
+    }
+    if (T.op[t] == Op::call) {
+        auto callee = T.root[T.back(t)];
+        return callee.type != FUN || p.fun_names[callee.getval()][0] != 't';
+    }
+    return true;
+}
+
+bool PreheaderFits(Program& p, Function* f, CFG& g, LoopForest& F, int l) {
+    auto& T = f->trees;
+    int h = F.loops[l].header;
+    if (T.op[g.inst[g.first[h]]] != Op::label) {
+        return false;
+    }
+    if (h == 0) {
+        return true;
+    }
+    if (Falls(p, g, T, h - 1) && F.contains(l, h - 1)) {
+        return false;
+    }
+    for (auto b : g.pred[h]) {
+        if (!F.contains(l, b)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int InsertPreheaders(Program& p, Function* f, CFG& g, LoopForest& F, const std::vector<std::vector<Node>>& trees) {
+    auto& T = f->trees;
+    std::vector<int> ahead (g.size, -1);
+    std::vector<Node> labels (F.loops.size(), NIL);
+    for (int l = 0; l < (int)F.loops.size(); l++) {
+        if (trees[l].empty()) {
+            continue;
+        }
+        auto h = F.loops[l].header;
+        auto head = g.inst[g.first[h]];
+        ahead[g.first[h]] = l;
+        for (auto b : g.pred[h]) {
+            auto t = g.inst[g.last[b]];
+            if (F.contains(l, b) || t == NIL || (T.op[t] != Op::br && T.op[t] != Op::cjmp) || T.root[t] != T.root[head]) {
+                continue;
+            }
+            if (labels[l] == NIL) {
+                labels[l] = T.make(Label(++p.global_label_count), Op::label);
+            }
+            T.root[t] = T.root[labels[l]];
+        }
+    }
+
+    /* each preheader right before its header, joining a context falling into it */
+    int added = 0;
+    std::vector<Context*> contexts;
+    for (auto c : f->contexts) {
+        auto front = c->trees.front();
+        int id = T.id_in_func[front];
+        int l = id < g.size && g.inst[id] == front ? ahead[id] : -1;
+        if (l >= 0) {
+            added++;
+            if (labels[l] != NIL) {
+                auto lc = p.arena.make<Context>();
+                lc->trees.push_back(labels[l]);
+                contexts.push_back(lc);
+            }
+            auto o = contexts.empty() ? Op::label : T.op[contexts.back()->trees.back()];
+            if (o == Op::label || o == Op::call || o == Op::br || o == Op::cjmp || o == Op::ret) {
+                contexts.push_back(p.arena.make<Context>());
+            }
+            auto& to = contexts.back()->trees;
+            to.insert(to.end(), trees[l].begin(), trees[l].end());
+        }
+        contexts.push_back(c);
+    }
+    f->contexts = contexts;
+    Renumber(f);
+    return added;
+}
+
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+
+#include <dom.h>
+
+namespace L3 {
+
+  /* a natural loop, the blocks reaching one of its back edges without going through its header */
+  class Loop {
+    public:
+      int header;
+      std::vector<int> blocks;    // in increasing order, the header included
+      std::vector<int> latches;   // blocks with a back edge to the header
+      std::vector<int> exits;     // blocks of the loop with a successor outside it
+      int parent = -1;            // innermost loop containing this one, -1 for an outermost loop
+      int depth = 1;
+  };
+
+  /*
+   * loop nesting forest of the blocks of a CFG
+   *   a back edge goes to a block dominating its source, the loops of one header are a single loop,
+   *   a loop comes before the loops it contains, unreachable blocks are in none
+   */
+  class LoopForest {
+    public:
+      LoopForest (DomTree& D);
+
+      bool contains(int l, int b) const;   // block b is in loop l or in a loop it contains
+
+      DomTree& D;
+      std::vector<Loop> loops;
+      std::vector<int> loop_of;            // innermost loop of each block, -1 outside any
+  };
+
+  /*
+   * preheaders, trees run once on the way into a loop, right above its header
+   *   a loop can have one when its header starts with a label and the block above does not fall into it from inside the loop,
+   *   the jumps from outside the loop to the header then go to a new label ahead of the trees
+   * the trees of each loop are inserted while the header labels still have the ids of the CFG, the function is renumbered
+   */
+  bool PreheaderFits(Program& p, Function* f, CFG& g, LoopForest& F, int l);
+  int InsertPreheaders(Program& p, Function* f, CFG& g, LoopForest& F, const std::vector<std::vector<Node>>& trees);
+
+}
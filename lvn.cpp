@@ -0,0 +1,795 @@
+#include <algorithm>
+
+#include <lvn.h>
+
+namespace L3 {
+
+    /* an operation on the value numbers of its operands, or a constant, label or callee by its item */
+    class ValueKey {
+      public:
+        bool operator== (const ValueKey& k) const { return op == k.op && a == k.a && b == k.b; }
+
+        int op;
+        int64_t a;
+        int64_t b;
+    };
+
+    /* value numbers by their key, open addressing, emptied by moving on to the next scope
+       which starts small again, most contexts are a few trees and stay in the first slots */
+    class ValueTable {
+      public:
+        int& find(const ValueKey& k, bool& found) {
+            if (2 * (used + 1) > mask + 1) {
+                grow();
+            }
+            size_t h = Hash(k) & mask;
+            while (slots[h].stamp == stamp && !(slots[h].key == k)) {
+                h = (h + 1) & mask;
+            }
+            auto& e = slots[h];
+            found = e.stamp == stamp;
+            if (!found) {
+                e.stamp = stamp;
+                e.key = k;
+                used++;
+            }
+            return e.number;
+        }
+        void clear() {
+            stamp++;
+            used = 0;
+            mask = 63;
+            if (slots.size() < mask + 1) {
+                slots.resize(mask + 1);
+            }
+        }
+
+      private:
+        class Slot {
+          public:
+            ValueKey key;
+            int number = 0;
+            int stamp = 0;
+        };
+
+        static size_t Hash(const ValueKey& k) {
+            uint64_t h = (k.a * 0x9e3779b97f4a7c15ull) ^ (k.b * 0xc2b2ae3d27d4eb4full) ^ k.op;
+            return h ^ (h >> 29);
+        }
+        void grow() {
+            moved.clear();
+            for (size_t i = 0; i <= mask && i < slots.size(); i++) {
+                if (slots[i].stamp == stamp) {
+                    moved.push_back(slots[i]);
+                }
+            }
+            mask = 2 * mask + 1;
+            if (slots.size() < mask + 1) {
+                slots.resize(mask + 1);
+            }
+            stamp++;
+            used = 0;
+            bool found;
+            for (auto& e : moved) {
+                find(e.key, found) = e.number;
+            }
+        }
+
+        std::vector<Slot> slots;
+        std::vector<Slot> moved;
+        size_t mask = 0;
+        int stamp = 1;
+        size_t used = 0;
+    };
+
+    /* an expression a later tree can get computed once ahead of tree, the tree first computing it inside */
+    class Candidate {
+      public:
+        Node node = NIL;
+        Node tree = NIL;
+        Node parent = NIL;
+        int slot = 0;
+        Context* context = NULL;   // of tree
+        int block = 0;             // of the context, the candidate serves the blocks it dominates
+        int scope = -1;
+    };
+
+    /* what the scope knows of a var, together as the vars of a function are many */
+    class VarState {
+      public:
+        int value = 0;
+        int scope = -1;         // the value is from this scope only
+        int written = -1;       // walk of a tree last writing the var
+        int inner = -1;         // walk of a tree writing the var below its root
+        int writes = 0;         // how many nodes of it do
+        Context* from = NULL;   // context last writing the var
+    };
+
+    /* lists of ints by a key, one after the other in a single vector, list[start[k]] up to list[start[k + 1]] */
+    class Buckets {
+      public:
+        void fill(int keys, const std::vector<std::pair<int, int>>& pairs) {   // key, int
+            start.assign(keys + 1, 0);
+            for (auto& e : pairs) {
+                start[e.first + 1]++;
+            }
+            for (int k = 0; k < keys; k++) {
+                start[k + 1] += start[k];
+            }
+            list.resize(pairs.size());
+            std::vector<int> at (start.begin(), start.end() - 1);
+            for (auto& e : pairs) {
+                list[at[e.first]++] = e.second;
+            }
+        }
+
+        std::vector<int> start;
+        std::vector<int> list;
+    };
+
+    static bool Pure(Op op) {
+        return op <= Op::c_e;
+    }
+
+    /* an operation hashed on its operands, a load on the memory it reads too */
+    static bool Numbered(Op op) {
+        return Pure(op) || op == Op::load;
+    }
+
+    static bool Commutative(Op op) {
+        return op == Op::add || op == Op::mult || op == Op::band || op == Op::c_e;
+    }
+
+    /* inner nodes below node i that an expression can repeat in, counting up to n */
+    static int Inner(TreePool& T, Node i, int n) {
+        int found = 0;
+        for (int k = 0; k < T.size(i) && found < n; k++) {
+            Node j = T.leaf(i, k);
+            if (T.op[j] != Op::leaf) {
+                found += Numbered(T.op[j]) + Inner(T, j, n - found - Numbered(T.op[j]));
+            }
+        }
+        return found;
+    }
+
+    static const int MEMORY = 0;   // no var, the memory the loads read, a new value at each store and call
+
+    /*
+     * value numbering of one function, a scope at a time, a context or the function, values are numbered from 0 in each
+     * and the vars are known by the scope they got a value in,
+     * down the dominator tree the vars and the holders a block changed are put back on leaving the blocks it dominates
+     */
+    class Lvn {
+      public:
+        Lvn (Function* f, DomTree* D, const std::function<int(Node)>& cost, LvnStats& stats)
+          : f {f}, T {f->trees}, D {D}, cost {cost}, stats {stats} {}
+
+        void run();
+
+      private:
+        void begin();
+        void down();
+        void place(Buckets& in, Buckets& joins);
+        void visit(Context* x, int b);
+        int fresh();
+        int var(int v);
+        int held(int n);
+        Node first(int n);
+        void hold(int v, int n, Context* x);
+        void write(int v, int n);
+        void walk(Node tree);
+        void forget(Node tree);
+        int number(Node i, Node parent, int slot, Node tree);
+        bool alone(int h, Node j, Node tree);
+        bool reaches(int a, int b);
+        bool share(Node i, Node tree);
+        bool replace(Node j, Node parent, int slot, Node tree);
+        bool hoist(Node j, Node parent, int slot, Node tree);
+        void rename(Node i, std::vector<std::pair<int, int>>& names, std::vector<std::pair<Node, Item>>& saved);
+        void adopt(Node i, Node tree);
+        void drop(Node i);
+        int position(Context* x, Node tree);
+
+        Function* f;
+        TreePool& T;
+        DomTree* D;
+        Context* c = NULL;   // being numbered
+        int block = 0;       // of c
+        const std::function<int(Node)>& cost;
+        LvnStats& stats;
+
+        ValueTable table;
+        std::vector<VarState> vars;
+        std::vector<int> holder;                 // var holding each value, as the root of a tree
+        std::vector<Candidate> candidate;        // first inner node computing each value
+        std::vector<int> value;                  // of each node, by the last walk of its tree
+        std::vector<int> reuse;                  // var holding the value of each node where it runs, 0 if none
+        std::vector<bool> clean;                 // node reading no var its tree wrote before
+        std::vector<int> marked;                 // values the walk of a tree made it the candidate of
+        std::vector<Node> path;                  // nodes above the one share looks at
+        std::vector<std::pair<int, int>> undo;
+        std::vector<std::pair<int, VarState>> scoped;
+        std::vector<std::pair<int, int>> holders;
+        int values = 0;
+        int scope = 0;
+        int walks = 0;
+    };
+
+    void Lvn::begin() {
+        scope++;
+        table.clear();
+        values = 0;
+        holder.clear();
+        candidate.clear();
+    }
+
+    int Lvn::fresh() {
+        holder.push_back(0);
+        candidate.push_back(Candidate());
+        return values++;
+    }
+
+    /* value of var v, a new one the first time the scope reads it */
+    int Lvn::var(int v) {
+        if (v >= (int)vars.size()) {
+            vars.resize(v + 1);
+        }
+        auto& x = vars[v];
+        if (x.scope != scope) {
+            x.scope = scope;
+            x.value = fresh();
+        }
+        return x.value;
+    }
+
+    /* the var holding value n, 0 when none does any more */
+    int Lvn::held(int n) {
+        int h = holder[n];
+        return h && vars[h].scope == scope && vars[h].value == n ? h : 0;
+    }
+
+    /* the inner node first computing value n in a context running before c, NIL if none */
+    Node Lvn::first(int n) {
+        auto& k = candidate[n];
+        return k.scope == scope && (k.block == block || (D && D->dominates(k.block, block))) ? k.node : NIL;
+    }
+
+    /* new var v holds value n from a tree of context x on */
+    void Lvn::hold(int v, int n, Context* x) {
+        if (v >= (int)vars.size()) {
+            vars.resize(v + 1);
+        }
+        if (D) {
+            scoped.push_back({v, vars[v]});
+        }
+        vars[v].scope = scope;
+        vars[v].value = n;
+        vars[v].from = x;
+        if (D) {
+            holders.push_back({n, holder[n]});
+        }
+        holder[n] = v;
+    }
+
+    void Lvn::write(int v, int n) {
+        var(v);
+        undo.push_back({v, vars[v].value});
+        if (D) {
+            scoped.push_back({v, vars[v]});
+        }
+        vars[v].value = n;
+        vars[v].written = walks;
+        vars[v].from = c;
+    }
+
+    /*
+     * value of node i, its operands first and the var it writes last, as the tile runs them,
+     * noting which var holds each value where it runs and which inner nodes compute one first
+     */
+    int Lvn::number(Node i, Node parent, int slot, Node tree) {
+        auto op = T.op[i];
+        auto it = T.root[i];
+        int n;
+        if (op == Op::leaf) {
+            if (it.type == VAR) {
+                n = var(it.getval());
+                clean[i] = vars[it.getval()].written != walks;
+            } else {
+                bool found;
+                int& e = table.find(ValueKey {Op::leaf, it.type, it.getval()}, found);
+                n = found ? e : e = fresh();
+                clean[i] = true;
+            }
+            value[i] = n;
+            return n;
+        }
+
+        bool all = true;
+        int64_t l = 0;
+        int64_t r = 0;
+        for (int k = 0; k < T.size(i); k++) {
+            Node j = T.leaf(i, k);
+            int v = number(j, i, k, tree);
+            all = all && clean[j];
+            (k == 0 ? l : r) = v;
+        }
+        clean[i] = all;
+        if (op == Op::asmt) {
+            n = l;
+        } else if (Pure(op)) {
+            auto p = static_cast<Op>(op <= Op::s_rn && op % 2 ? op - 1 : op);   // add for addn, on a constant leaf alike
+            if (Commutative(p) && r < l) {
+                std::swap(l, r);
+            }
+            bool found;
+            int& e = table.find(ValueKey {p, l, r}, found);
+            n = found ? e : e = fresh();
+        } else if (op == Op::load) {
+            bool found;
+            int& e = table.find(ValueKey {Op::load, l, var(MEMORY)}, found);
+            n = found ? e : e = fresh();
+        } else {
+            n = fresh();
+        }
+        if (op == Op::store || op == Op::call) {
+            write(MEMORY, fresh());
+        }
+        value[i] = n;
+
+        int h = held(n);
+        reuse[i] = h && vars[h].written != walks ? h : 0;   // not a var the tree wrote, a subtree of it may be gone
+        if (i != tree && Numbered(op) && clean[i] && first(n) == NIL && !h) {
+            candidate[n] = Candidate {i, tree, parent, slot, c, block, scope};
+            marked.push_back(n);
+        }
+        if (it.type == VAR) {
+            int v = it.getval();
+            write(v, n);
+            if (i != tree) {
+                auto& x = vars[v];
+                x.writes = x.inner == walks ? x.writes + 1 : 1;
+                x.inner = walks;
+            }
+        }
+        return n;
+    }
+
+    /* the vars a tree writes and the values it computes first, the root var holding its value */
+    void Lvn::walk(Node tree) {
+        if (value.size() < T.root.size()) {
+            value.resize(2 * T.root.size(), 0);
+            reuse.resize(value.size(), 0);
+            clean.resize(value.size(), true);
+        }
+        walks++;
+        undo.clear();
+        marked.clear();
+        int n = number(tree, NIL, 0, tree);
+        if (T.root[tree].type == VAR && !held(n)) {
+            if (D) {
+                holders.push_back({n, holder[n]});
+            }
+            holder[n] = T.root[tree].getval();
+        }
+    }
+
+    /* the walk of a tree about to change undone, the values it computes first in a tree it got moved to aside */
+    void Lvn::forget(Node tree) {
+        for (auto n : marked) {
+            if (candidate[n].tree == tree) {
+                candidate[n].node = NIL;
+            }
+        }
+        for (int u = undo.size() - 1; u >= 0; u--) {
+            vars[undo[u].first].value = undo[u].second;
+        }
+    }
+
+    int Lvn::position(Context* x, Node tree) {
+        for (int k = 0; k < (int)x->trees.size(); k++) {
+            if (x->trees[k] == tree) {
+                return k;
+            }
+        }
+        return -1;
+    }
+
+    /*
+     * var h written inside tree only by node j and the nodes above it, which run after j,
+     * a tile runs the subtrees it leaves before reading its leaves, in either order
+     */
+    bool Lvn::alone(int h, Node j, Node tree) {
+        if (vars[h].inner != walks) {
+            return true;
+        }
+        int n = 0;
+        for (auto i : path) {
+            n += i != tree && T.root[i].type == VAR && T.root[i].getval() == h;
+        }
+        n += T.root[j].type == VAR && T.root[j].getval() == h;
+        return n == vars[h].writes;
+    }
+
+    /* every path from block a returning from the function goes through block b, the ones ending in an error call do not count */
+    bool Lvn::reaches(int a, int b) {
+        auto& g = D->g;
+        std::vector<bool> seen (g.blocks(), false);
+        std::vector<int> todo {a};
+        seen[a] = true;
+        while (!todo.empty()) {
+            int x = todo.back();
+            todo.pop_back();
+            auto i = g.inst[g.last[x]];
+            if (g.succ[x].empty() && (i == NIL || T.op[i] != Op::call)) {
+                return false;
+            }
+            for (auto y : g.succ[x]) {
+                if (y != b && !seen[y]) {
+                    seen[y] = true;
+                    todo.push_back(y);
+                }
+            }
+        }
+        return true;
+    }
+
+    /* node j of tree, or the whole tree when j is it, as a read of var h, kept when the tree gets cheaper */
+    bool Lvn::replace(Node j, Node parent, int slot, Node tree) {
+        int h = reuse[j];
+        if (j != tree && !alone(h, j, tree)) {
+            return false;
+        }
+        stats.trials++;
+        int before = cost(tree);
+        auto leaf = T.make(Var(h), Op::leaf);
+        bool across = vars[h].from != c;
+        if (j == tree) {
+            auto op = T.op[j];
+            auto l = T.left[j];
+            auto r = T.right[j];
+            T.op[j] = Op::asmt;
+            T.left[j] = leaf;
+            T.right[j] = NIL;
+            if (cost(tree) < before) {
+                stats.across += across;
+                return true;
+            }
+            T.op[j] = op;
+            T.left[j] = l;
+            T.right[j] = r;
+        } else {
+            T.leaf(parent, slot) = leaf;
+            if (cost(tree) < before) {
+                stats.across += across;
+                return true;
+            }
+            T.leaf(parent, slot) = j;
+        }
+        stats.rejected++;
+        return false;
+    }
+
+    /* the vars written by the inner nodes of a subtree about to be computed ahead of its tree, renamed to new ones */
+    void Lvn::rename(Node i, std::vector<std::pair<int, int>>& names, std::vector<std::pair<Node, Item>>& saved) {
+        if (T.op[i] == Op::leaf) {
+            return;
+        }
+        for (int k = 0; k < T.size(i); k++) {
+            rename(T.leaf(i, k), names, saved);
+        }
+        if (T.root[i].type != VAR) {
+            return;
+        }
+        int v = T.root[i].getval();
+        int n = 0;
+        for (auto& e : names) {
+            n = e.first == v ? e.second : n;
+        }
+        if (!n) {
+            n = ++f->var_count;
+            names.push_back({v, n});
+        }
+        saved.push_back({i, T.root[i]});
+        T.root[i] = Var(n);
+    }
+
+    /* the inner nodes first computing a value below node i now do so in tree */
+    void Lvn::adopt(Node i, Node tree) {
+        if (T.op[i] == Op::leaf) {
+            return;
+        }
+        if (candidate[value[i]].node == i) {
+            candidate[value[i]].tree = tree;
+        }
+        for (int k = 0; k < T.size(i); k++) {
+            adopt(T.leaf(i, k), tree);
+        }
+    }
+
+    /* node i is gone from its tree, the values first computed below it with it */
+    void Lvn::drop(Node i) {
+        if (T.op[i] == Op::leaf) {
+            return;
+        }
+        if (candidate[value[i]].node == i) {
+            candidate[value[i]].node = NIL;
+        }
+        for (int k = 0; k < T.size(i); k++) {
+            drop(T.leaf(i, k));
+        }
+    }
+
+    /*
+     * node j of tree computed again, as the inner node s of an earlier tree a, or of tree itself before j:
+     * s becomes a tree of its own ahead of a, a and tree read the new var it writes, kept when the trees get cheaper,
+     * and a no dearer when its block may run without the block of tree
+     */
+    bool Lvn::hoist(Node j, Node parent, int slot, Node tree) {
+        auto& k = candidate[value[j]];
+        Node s = k.node;
+        Node a = k.tree;
+        Context* x = k.context;
+        stats.trials++;
+        int at = cost(a);
+        int before = at + (a != tree ? cost(tree) : 0);
+
+        std::vector<std::pair<int, int>> names;
+        std::vector<std::pair<Node, Item>> saved;
+        int vars = f->var_count;
+        rename(s, names, saved);
+        int pos = position(x, a);
+        x->trees.insert(x->trees.begin() + pos, s);
+        auto inside = T.make(T.root[s], Op::leaf);
+        auto leaf = T.make(T.root[s], Op::leaf);
+        T.leaf(k.parent, k.slot) = inside;
+        bool root = j == tree;
+        auto op = T.op[j];
+        auto l = T.left[j];
+        auto r = T.right[j];
+        if (root) {
+            T.op[j] = Op::asmt;
+            T.left[j] = leaf;
+            T.right[j] = NIL;
+        } else {
+            T.leaf(parent, slot) = leaf;
+        }
+
+        int ahead = cost(s) + cost(a);
+        if (ahead + (a != tree ? cost(tree) : 0) < before && (k.block == block || ahead <= at || reaches(k.block, block))) {
+            hold(T.root[s].getval(), value[s], x);
+            adopt(s, s);
+            k.node = NIL;
+            stats.hoisted++;
+            stats.across += x != c;
+            return true;
+        }
+
+        if (root) {
+            T.op[j] = op;
+            T.left[j] = l;
+            T.right[j] = r;
+        } else {
+            T.leaf(parent, slot) = j;
+        }
+        T.leaf(k.parent, k.slot) = s;
+        x->trees.erase(x->trees.begin() + pos);
+        for (auto& e : saved) {
+            T.root[e.first] = e.second;
+        }
+        f->var_count = vars;
+        stats.rejected++;
+        return false;
+    }
+
+    /* the largest repeated subtrees of node i, top down */
+    bool Lvn::share(Node i, Node tree) {
+        bool changed = false;
+        path.push_back(i);
+        for (int k = 0; k < T.size(i); k++) {
+            Node j = T.leaf(i, k);
+            if (T.op[j] == Op::leaf) {
+                continue;
+            }
+            auto s = first(value[j]);
+            if (Numbered(T.op[j]) && (reuse[j] ? replace(j, i, k, tree) : s != NIL && s != j && hoist(j, i, k, tree))) {
+                drop(j);
+                stats.reused++;
+                changed = true;
+                continue;
+            }
+            changed = share(j, tree) || changed;
+        }
+        path.pop_back();
+        return changed;
+    }
+
+    /* the trees of context x, in block b */
+    void Lvn::visit(Context* x, int b) {
+        c = x;
+        block = b;
+        for (int k = 0; k < (int)c->trees.size(); k++) {
+            Node t = c->trees[k];
+            walk(t);
+
+            bool whole = Numbered(T.op[t]) && T.root[t].type == VAR;
+            if (whole && reuse[t] == T.root[t].getval()) {   // the var already holds it, the last tree of a context is kept
+                if (k < (int)c->trees.size() - 1) {
+                    forget(t);
+                    c->trees.erase(c->trees.begin() + k--);
+                    stats.moves++;
+                    stats.reused++;
+                    continue;
+                }
+                whole = false;
+            }
+            auto s = first(value[t]);
+            bool changed;
+            if (whole && (reuse[t] ? replace(t, NIL, 0, t) : s != NIL && hoist(t, NIL, 0, t))) {
+                stats.reused++;
+                changed = true;
+            } else {
+                changed = share(t, t);   // what earlier trees and the tree itself computed before, the largest first
+            }
+            if (changed) {
+                forget(t);
+                walk(t);
+                k = position(c, t);
+            }
+        }
+    }
+
+    /* blocks joining the values of each var and of the memory, the iterated dominance frontier of the blocks writing it */
+    void Lvn::place(Buckets& in, Buckets& joins) {
+        int n = D->g.blocks();
+        std::vector<std::pair<int, int>> pairs;   // var, block writing it
+        std::vector<int> last (f->var_count + 1, -1);
+        std::vector<Node> todo;
+        auto writes = [&](int v, int b) {
+            if (last[v] != b) {
+                last[v] = b;
+                pairs.push_back({v, b});
+            }
+        };
+        for (int b = 0; b < n; b++) {
+            for (int u = in.start[b]; u < in.start[b + 1]; u++) {
+                for (auto t : f->contexts[in.list[u]]->trees) {
+                    todo.push_back(t);
+                    while (!todo.empty()) {
+                        Node i = todo.back();
+                        todo.pop_back();
+                        if (T.op[i] == Op::leaf) {
+                            continue;
+                        }
+                        if (T.op[i] == Op::store || T.op[i] == Op::call) {
+                            writes(MEMORY, b);
+                        }
+                        if (T.root[i].type == VAR) {
+                            writes(T.root[i].getval(), b);
+                        }
+                        for (int k = 0; k < T.size(i); k++) {
+                            todo.push_back(T.leaf(i, k));
+                        }
+                    }
+                }
+            }
+        }
+        Buckets blocks;
+        blocks.fill(f->var_count + 1, pairs);
+
+        pairs.clear();   // block, var joined there
+        std::vector<int> placed (n, -1);
+        std::vector<int> added (n, -1);
+        std::vector<int> work;
+        for (int v = 0; v <= f->var_count; v++) {
+            work.assign(blocks.list.begin() + blocks.start[v], blocks.list.begin() + blocks.start[v + 1]);
+            for (auto b : work) {
+                added[b] = v;
+            }
+            while (!work.empty()) {
+                int b = work.back();
+                work.pop_back();
+                for (auto y : D->frontier[b]) {
+                    if (placed[y] == v) {
+                        continue;
+                    }
+                    placed[y] = v;
+                    pairs.push_back({y, v});
+                    stats.joins++;
+                    if (added[y] != v) {
+                        added[y] = v;
+                        work.push_back(y);
+                    }
+                }
+            }
+        }
+        joins.fill(n, pairs);
+    }
+
+    /*
+     * the contexts of a function down its dominator tree, one scope, a block seeing the values of the blocks dominating it,
+     * a var written on the way to a join from a block not dominating it gets a new value there, read or not,
+     * as any var may become the one a later tree reads a value from
+     * the contexts no path from the entry reaches are numbered each on its own
+     */
+    void Lvn::down() {
+        auto& g = D->g;
+        int n = g.blocks();
+        begin();
+        if (n == 0) {
+            return;
+        }
+        std::vector<std::pair<int, int>> pairs;   // block, context in it
+        for (int k = 0; k < (int)f->contexts.size(); k++) {
+            auto x = f->contexts[k];
+            if (!x->trees.empty()) {
+                pairs.push_back({g.block_of[T.id_in_func[x->trees[0]]], k});
+            }
+        }
+        Buckets in;
+        Buckets joins;
+        in.fill(n, pairs);
+        place(in, joins);
+
+        std::vector<std::pair<int, int>> stack;           // block, next child to visit
+        std::vector<std::pair<int, int>> marks;           // lengths of the logs when each block on the stack was entered
+        auto enter = [&](int b) {
+            marks.push_back({scoped.size(), holders.size()});
+            stack.push_back({b, 0});
+            c = NULL;
+            for (int u = joins.start[b]; u < joins.start[b + 1]; u++) {
+                write(joins.list[u], fresh());
+            }
+            for (int u = in.start[b]; u < in.start[b + 1]; u++) {
+                visit(f->contexts[in.list[u]], b);
+            }
+        };
+        scoped.clear();
+        holders.clear();
+        enter(0);
+        while (!stack.empty()) {
+            auto& top = stack.back();
+            if (top.second < (int)D->children[top.first].size()) {
+                enter(D->children[top.first][top.second++]);
+                continue;
+            }
+            for (int u = scoped.size() - 1; u >= marks.back().first; u--) {
+                vars[scoped[u].first] = scoped[u].second;
+            }
+            for (int u = holders.size() - 1; u >= marks.back().second; u--) {
+                holder[holders[u].first] = holders[u].second;
+            }
+            scoped.resize(marks.back().first);
+            holders.resize(marks.back().second);
+            marks.pop_back();
+            stack.pop_back();
+        }
+
+        for (int b = 0; b < n; b++) {
+            if (!D->reachable(b)) {
+                for (int u = in.start[b]; u < in.start[b + 1]; u++) {
+                    scope++;
+                    visit(f->contexts[in.list[u]], b);
+                }
+            }
+        }
+    }
+
+    void Lvn::run() {
+        if (D) {
+            down();
+            return;
+        }
+        for (auto x : f->contexts) {
+            if (x->trees.size() == 1 && Inner(T, x->trees[0], 2) < 2) {   // a lone tree has to repeat itself
+                continue;
+            }
+            begin();
+            visit(x, 0);
+        }
+    }
+
+    void NumberValues(Function* f, DomTree* D, const std::function<int(Node)>& cost, LvnStats& stats) {
+        Lvn(f, D, cost, stats).run();
+    }
+
+}
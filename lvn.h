@@ -0,0 +1,32 @@
+#pragma once
+
+#include <functional>
+
+#include <L3.h>
+#include <dom.h>
+
+namespace L3 {
+
+  class LvnStats {
+    public:
+      int64_t reused = 0;     // repeated expressions read from the var already holding them
+      int64_t hoisted = 0;    // of which computed once into a new var, ahead of the tree first computing them
+      int64_t across = 0;     // of which held or first computed in a context dominating theirs
+      int64_t moves = 0;      // trees left assigning a var to itself, removed
+      int64_t trials = 0;     // rewrites priced by the tiles
+      int64_t rejected = 0;   // of which not cheaper, undone
+      int64_t joins = 0;      // vars given a new value where the paths writing them meet
+  };
+
+  /*
+   * value numbering of the trees of a function, hashing each operation on the value numbers of its operands
+   *   an expression computed again reads the var holding it, the root of an earlier tree still holding it,
+   *   or a new var the first tree computing it inside gets its subtree moved into,
+   *   a rewrite is kept only when cost, the cheapest tiling of a tree, says the trees it touches got cheaper,
+   *   so a node a tile covers for free is never shared
+   * each context on its own without dominators, with them the contexts go down the dominator tree
+   * and a context reads what the contexts dominating it computed, the vars written on the way to a join getting new values there
+   */
+  void NumberValues(Function* f, DomTree* D, const std::function<int(Node)>& cost, LvnStats& stats);
+
+}
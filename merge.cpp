@@ -2,224 +2,304 @@
 #include <iostream>
 #include <fstream>
 #include <cassert>
+#include <algorithm>
+#include <cstdint>
 
 
 
 #include <merge.h>
+#include <liveness.h>
+#include <report.h>
 
 //#define NDEBUG
 
 using namespace std;
 
 namespace L3{
-  bool sets_cmp_insert(std::set<int>* b, std::set<int>* a);
-  bool sets_cmp_erase(std::set<int>* b, std::set<int>* a);
-  bool sets_cmp_intersect(std::set<int>* b, std::set<int>* a);
-  void graft(Tree* a, Tree* b);
+  bool graft(TreePool& T, Node a, Node b);
 
-  /* liveness analysis */
-  void MergeTree(Program &p) {
+  const int NONE_AFTER = INT32_MAX;  // no such position down the context
+
+  /*
+   * leftist min-heaps of positions in a context, one per tree, melded when a tree is grafted into another
+   */
+  class PositionHeaps {
+    public:
+      int make(int key) {
+        key_.push_back(key);
+        left.push_back(-1);
+        right.push_back(-1);
+        dist.push_back(1);
+        return key_.size() - 1;
+      }
+      int meld(int a, int b) {
+        if (a < 0) return b;
+        if (b < 0) return a;
+        if (key_[b] < key_[a]) { int t = a; a = b; b = t; }
+        right[a] = meld(right[a], b);
+        if (left[a] < 0 || dist[left[a]] < dist[right[a]]) { int t = left[a]; left[a] = right[a]; right[a] = t; }
+        dist[a] = right[a] < 0 ? 1 : dist[right[a]] + 1;
+        return a;
+      }
+      int pop(int h) { return meld(left[h], right[h]); }
+      int key(int h) const { return h < 0 ? NONE_AFTER : key_[h]; }
+      void clear() { key_.clear(); left.clear(); right.clear(); dist.clear(); }
+
+    private:
+      std::vector<int> key_;
+      std::vector<int> left;
+      std::vector<int> right;
+      std::vector<int> dist;
+  };
+
+  /* whether tree t reads or writes var v, the tile may run the operands of a tree in any order */
+  bool touches(TreePool& T, Node t, int v) {
+      if(T.root[t].type == VAR && T.root[t].getval() == v) {
+          return true;
+      }
+      for(int it = 0; T.op[t] != Op::leaf && it < T.size(t); it++) {
+          if(touches(T, T.leaf(t, it), v)) {
+              return true;
+          }
+      }
+      return false;
+  }
+
+  /* vars written inside a tree by the trees grafted into it */
+  void inner_roots(TreePool& T, Node t, std::vector<int>& roots) {
+      for(int it = 0; it < T.size(t); it++) {
+          auto l = T.leaf(t, it);
+          if(T.op[l] != Op::leaf) {
+              if(T.root[l].type == VAR) {
+                  roots.push_back(T.root[l].getval());
+              }
+              inner_roots(T, l, roots);
+          }
+      }
+  }
+
+  /*
+   * remove the dead trees and merge the rest, on the liveness of each function
+   *   both are repeated until nothing changes, a removed tree can leave its operands dead
+   *   and a merge or a removal can clear the way for another merge
+   */
+  MergeStats MergeTree(Program &p, Analyses& a, int rounds) {
+    MergeStats stats;
     for(auto f : p.functions) {
-        int size = f->tree_count;
-        std::vector<std::set<int>*> GEN (size);
-        std::vector<std::set<int>*> KILL (size);
-        std::vector<std::set<int>*> IN (size);
-        std::vector<std::set<int>*> OUT (size);
-
-        std::vector<bool> JUMP (size, false);
-        std::vector<int> SUCCESSOR (size, 0); //no log for adjacent successor
-
-        /* generate the GEN and KILL set */
-        for(auto c : f->contexts) {
-	        for(auto t : c->trees) {
-                int i = t->id_in_func;
-		        GEN[i] = new std::set<int>;
-                KILL[i] = new std::set<int>;
-                IN[i] = new std::set<int>;
-                OUT[i] = new std::set<int>;
-            
-                if(t->op < Op::cjmp) {
-                    if(t->root != NULL && t->root->type == VAR) {
-                        KILL[i]->insert(t->root->getval());
-                    }
-                    for(auto l : t->leaves) {
-                        if(l->root->type == VAR) {
-                            GEN[i]->insert(l->root->getval());
-                        }
-                    }
-                    if (t->op == Op::ret) {
-                        SUCCESSOR[i] = 1;
-                    }
-                } else if (t->op == Op::call) {
-                    if(t->root != NULL) {
-                        KILL[i]->insert(t->root->getval());
-                    }
-                    for(int it = 0; it < t->leaves.size() - 2; it++) {
-                        if((t->leaves)[it]->root->type == ItemType::VAR) {
-                            GEN[i]->insert((t->leaves)[it]->root->getval());
-                        }
-                    }
-                    if(t->leaves.back()->root->type == ItemType::VAR) {
-                        GEN[i]->insert((t->leaves).back()->root->getval());
-                    } else if ((dynamic_cast<FunName*>(t->leaves.back()->root)->fun)[0] == 't') {
-                        SUCCESSOR[i] = 1;
-                    }
-                } else if (t->root->type == LABEL) {  //with dst of label
-                    if(t->op != Op::label) {
-                        JUMP[i] = true;
-                        if(t->op == Op::br) {  //goto
-                            SUCCESSOR[i] = f->label_id_map.find(t->root->getval())->second;
-                        } else {  //cjmp
-                            SUCCESSOR[i] = -1 - f->label_id_map.find(t->root->getval())->second;
-                            GEN[i]->insert((t->leaves)[0]->root->getval());
-                        }
-                    }
-                } else {
-                    assert(0);
-                }
-	        }
-        }
+        report.begin_function(f->name);
+        auto& T = f->trees;
+        auto& L = a.liveness(f);
+        auto& KILL = L.KILL;
 
-        /* generate the IN and OUT set */
-        bool isModified = false;
-        bool isInitial = true;
-        do {
-            isModified = false;
-            for(int i = size - 1; i >= 0; --i) {
-                if(JUMP[i] == false) {
-                    if(SUCCESSOR[i] == 0) { //normal
-                        isModified = sets_cmp_insert(OUT[i], IN[i + 1]) || isModified;
-                        isModified = sets_cmp_intersect(OUT[i], IN[i + 1]) || isModified;
-                    }
-                } else {
-                    if(SUCCESSOR[i] < 0) { //cjump
-                        std::set<int>* UNITE = new std::set<int>;
-                        sets_cmp_insert(UNITE, IN[i + 1]);
-                        sets_cmp_insert(UNITE, IN[-1 - SUCCESSOR[i]]);
-                        isModified = sets_cmp_insert(OUT[i], UNITE) || isModified;
-                        isModified = sets_cmp_intersect(OUT[i], UNITE) || isModified;
-                        delete UNITE;
-                    } else { //goto
-                        isModified = sets_cmp_insert(OUT[i], IN[SUCCESSOR[i]]) || isModified;
-                        isModified = sets_cmp_intersect(OUT[i], IN[SUCCESSOR[i]]) || isModified;
+        std::vector<int> lastDef (L.bits, NONE_AFTER);   // nearest def of each var down the context, while sweeping up
+        std::vector<int> lastUse (L.bits, NONE_AFTER);
+        std::vector<int> nextUse;                        // next use of the root var of each position
+        std::vector<int> nextDef;                        // next def of the root var of each position
+        std::vector<int> heap;                           // next defs of the vars read or written inside each position
+        std::vector<bool> removed;
+        std::vector<bool> grafted;                       // positions some tree was grafted into
+        std::vector<int> roots;
+        std::vector<int> inner;                          // vars written inside a tree, by the trees grafted into it
+        std::vector<int> written;                        // vars lastDef holds an inner def of
+        PositionHeaps H;
+
+        /* a context gives the same answer again unless its block, trees or liveness, changed since */
+        std::vector<int> dead_seen (f->contexts.size(), -1);
+        std::vector<int> merge_seen (f->contexts.size(), -1);
+        auto settled = [&](Context* c, int& seen) {
+            if(c->trees.empty()) {
+                return true;
+            }
+            int v = L.version[L.cfg.block_of[T.id_in_func[c->trees.back()]]];
+            if(seen == v) {
+                return true;
+            }
+            seen = v;
+            return false;
+        };
+
+        for(int round = 0; ; round++) {
+            int64_t dead = 0;
+            int64_t merged = 0;
+
+            /* dead trees, the last tree of a context is kept */
+            for(int ci = 0; ci < (int)f->contexts.size(); ci++) {
+                auto c = f->contexts[ci];
+                if(settled(c, dead_seen[ci])) {
+                    continue;
+                }
+                int n = c->trees.size();
+                int k = 0;
+                for(int i = 0; i < n; ++i) {
+                    int treeI = T.id_in_func[(c->trees)[i]];
+                    if(i < n - 1 && KILL[treeI] >= 0 && !L.live_out(treeI, KILL[treeI])) {
+                        L.remove(treeI);
+                        dead++;
+                        continue;
                     }
+                    (c->trees)[k++] = (c->trees)[i];
                 }
-                if(isModified || isInitial) {  // deal with the IN set only when necessary
-                    std::set<int>* UNITE = new std::set<int>;
-                    sets_cmp_insert(UNITE, OUT[i]);
-                    sets_cmp_erase(UNITE, KILL[i]);
-                    sets_cmp_insert(UNITE, GEN[i]);
-                    sets_cmp_insert(IN[i], UNITE);
-                    sets_cmp_intersect(IN[i], UNITE);
-                    delete UNITE;
+                if(k < n) {
+                    c->trees.resize(k);
+                    merge_seen[ci] = -1;
                 }
             }
-            isInitial = false;
-        } while(isModified);
-    
-        for(auto c : f->contexts) { 
-            int n = c->trees.size();
-            for(int i = 0; i < n - 1; ++i) {
-                int treeI = (c->trees)[i]->id_in_func;
-                if(KILL[treeI]->empty()) {
+
+            /* merge, with the positions in a context as def-use chains */
+            for(int ci = 0; ci < (int)f->contexts.size(); ci++) {
+                auto c = f->contexts[ci];
+                if(settled(c, merge_seen[ci])) {
                     continue;
                 }
-                auto rootI = *KILL[treeI]->begin();
-                if(OUT[treeI]->find(rootI) == OUT[treeI]->end()) {
-                    c->trees.erase(c->trees.begin() + i);
-                    i--;
-                    n--;
-                }
-            }
-        }
+                int n = c->trees.size();
+                nextUse.assign(n, NONE_AFTER);
+                nextDef.assign(n, NONE_AFTER);
+                heap.assign(n, -1);
+                removed.assign(n, false);
+                grafted.assign(n, false);
+                H.clear();
 
-        /* merge */
-        for(auto c : f->contexts) {
-            int n = c->trees.size();
-            for(int i = 0; i < n - 1; ++i) {
-                for(int j = i + 1; j < n; ++j) {
-
-                    int treeI = (c->trees)[i]->id_in_func;
-                    int treeJ = (c->trees)[j]->id_in_func;
-                    auto leavesJ = (c->trees)[j]->leaves;
-                    
-                    if(KILL[treeI]->empty()) {
-                        break;
-                    }
-                    auto rootI = *KILL[treeI]->begin();
-
-                    if(GEN[treeJ]->find(rootI) != GEN[treeJ]->end()) {   // rootI-leafJ match, to merge or to break treeI
-
-                        if(OUT[treeJ]->find(rootI) != OUT[treeJ]->end() && KILL[treeJ]->find(rootI) == KILL[treeJ]->end()  // rootI living, cannot merge
-                           || leavesJ.size() == 2 && leavesJ.front()->root->getval() == leavesJ.back()->root->getval()) {  // dupicated leaves of treeJ
-                            break;
-                        } else {   // merge
-                            sets_cmp_insert(GEN[treeJ], GEN[treeI]);   // merge the GEN set
-                            graft((c->trees)[i], (c->trees)[j]);
-                            c->trees.erase(c->trees.begin() + i);
-                            i--;
-                            n--;
-                            break;
-                        }
-                    } else {
-                        if(!KILL[treeJ]->empty()) {
-                            auto rootJ = *KILL[treeJ]->begin();
-                            if(rootI == rootJ) {  //redefine of rootI
-                                break;
-                            }
-                            if(GEN[treeI]->find(rootJ) != GEN[treeI]->end()) {  //redefine of leavesI
-                                break;
-                            }
-                    
+                for(int i = n - 1; i >= 0; --i) {
+                    int treeI = T.id_in_func[(c->trees)[i]];
+                    int rootI = KILL[treeI];
+                    roots.assign(L.uses.begin() + L.use_first[treeI], L.uses.begin() + L.use_end[treeI]);
+                    int own = roots.size();
+                    inner_roots(T, (c->trees)[i], roots);
+                    for(auto v : roots) {
+                        if(lastDef[v] != NONE_AFTER) {
+                            heap[i] = H.meld(heap[i], H.make(lastDef[v]));
                         }
                     }
+                    if(rootI >= 0) {
+                        nextUse[i] = lastUse[rootI];
+                        nextDef[i] = lastDef[rootI];
+                        lastDef[rootI] = i;
+                    }
+                    for(int r = own; r < (int)roots.size(); ++r) {   // after a round, trees write vars inside too
+                        lastDef[roots[r]] = i;
+                        written.push_back(roots[r]);
+                    }
+                    for(int u = L.use_first[treeI]; u < L.use_end[treeI]; ++u) {
+                        lastUse[L.uses[u]] = i;
+                    }
                 }
-            }
-        }
-    }
 
-    return ;
-  }
+                for(int i = 0; i < n - 1; ++i) {
+                    int treeI = T.id_in_func[(c->trees)[i]];
+                    int rootI = KILL[treeI];
 
-    bool sets_cmp_insert(std::set<int>* b, std::set<int>* a) {
-        bool isModified = false;
-        for (std::set<int>::iterator it = (*a).begin(); it != (*a).end(); ++it) {
-            if ((*b).find(*it) == (*b).end()) {
-                isModified = true;
-                (*b).insert(*it);
-            }
-        }
-        return isModified;
-    }
+                    /* the defs reaching i from the trees grafted into it are the def of i itself */
+                    bool redefined = false;
+                    while(H.key(heap[i]) <= i) {
+                        heap[i] = H.pop(heap[i]);
+                        redefined = true;
+                    }
+                    if(redefined && nextDef[i] != NONE_AFTER) {
+                        heap[i] = H.meld(heap[i], H.make(nextDef[i]));
+                    }
 
-    bool sets_cmp_erase(std::set<int>* b, std::set<int>* a) {
-        bool isModified = false;
-        for (auto it = (*a).begin(); it != (*a).end(); ++it) {
-            if ((*b).find(*it) != (*b).end()) {
-                isModified = true;
-                (*b).erase(*it);
+                    if(rootI < 0) {
+                        continue;
+                    }
+
+                    /* the first tree down the context which reads rootI, redefines it, or redefines a var of i */
+                    int j = std::min(nextUse[i], std::min(nextDef[i], H.key(heap[i])));
+                    if(j == NONE_AFTER || j != nextUse[i]) {
+                        continue;
+                    }
+
+                    int treeJ = T.id_in_func[(c->trees)[j]];
+                    auto nodeJ = (c->trees)[j];
+                    int reads = 0;
+                    for(int u = L.use_first[treeJ]; u < L.use_end[treeJ]; ++u) {
+                        reads += L.uses[u] == rootI;
+                    }
+                    if(L.live_out(treeJ, rootI) && KILL[treeJ] != rootI  // rootI living, cannot merge
+                       || T.size(nodeJ) == 2 && T.root[T.leaf(nodeJ, 0)] == T.root[T.leaf(nodeJ, 1)]  // dupicated leaves of treeJ
+                       || reads != 1) {
+                        continue;
+                    }
+                    inner.clear();
+                    inner_roots(T, nodeJ, inner);
+                    bool clash = false;
+                    for(auto v : inner) {
+                        clash = clash || touches(T, (c->trees)[i], v);
+                    }
+                    if(clash) {   // a var of i written inside j, maybe before i runs
+                        continue;
+                    }
+                    bool found = graft(T, (c->trees)[i], nodeJ);
+                    assert(found);
+                    heap[j] = H.meld(heap[j], heap[i]);   // merge the GEN set
+                    removed[i] = true;
+                    grafted[j] = true;
+                    merged++;
+                }
+
+                int k = 0;
+                for(int i = 0; i < n; ++i) {
+                    int treeI = T.id_in_func[(c->trees)[i]];
+                    for(int u = L.use_first[treeI]; u < L.use_end[treeI]; ++u) {
+                        lastUse[L.uses[u]] = NONE_AFTER;
+                    }
+                    if(KILL[treeI] >= 0) {
+                        lastDef[KILL[treeI]] = NONE_AFTER;
+                    }
+                    for(auto v : written) {
+                        lastDef[v] = NONE_AFTER;
+                    }
+                    written.clear();
+                    if(removed[i]) {
+                        L.remove(treeI);
+                        continue;
+                    }
+                    if(grafted[i]) {
+                        L.reread(treeI);
+                    }
+                    (c->trees)[k++] = (c->trees)[i];
+                }
+                c->trees.resize(k);
+            }
+            /* the merges ran on the liveness from before the removals, a superset of it, which is safe */
+            if((dead || merged) && round + 1 < rounds) {
+                L.update();
             }
-        }
-        return isModified;
-    }
 
-    bool sets_cmp_intersect(std::set<int>* b, std::set<int>* a) {
-        bool isModified = false;
-        for (auto it = (*b).begin(); it != (*b).end(); ++it) {
-            if ((*a).find(*it) == (*a).end()) {
-                isModified = true;
-                (*b).erase(*it);
+            stats.dead += dead;
+            stats.merged += merged;
+            if(round > 0) {
+                stats.dead_later += dead;
+                stats.merged_later += merged;
+            }
+            if((!dead && !merged) || round + 1 == rounds) {
+                stats.rounds = std::max(stats.rounds, (int64_t)round + 1);
+                break;
             }
         }
-        return isModified;
+        stats.live_updates += L.updates;
+        report.end_function();
     }
 
-    void graft(Tree* a, Tree* b) {
-        for(auto& i : b->leaves) {
-            if(i->root->getval() == a->root->getval()) {
-                i = a;
-                return;
+    return stats;
+  }
+
+  void MergePass::run(Program& p, Analyses& a, int optLevel) {
+    stats = MergeTree(p, a, optLevel >= 2 ? INT32_MAX : 1);
+  }
+
+    /* replace the leaf of b reading the root of a with a, b can hold trees grafted before */
+    bool graft(TreePool& T, Node a, Node b) {
+        for(int it = 0; it < T.size(b); it++) {
+            Node& i = T.leaf(b, it);
+            if(T.op[i] == Op::leaf) {
+                if(T.root[i] == T.root[a]) {
+                    i = a;
+                    return true;
+                }
+            } else if(graft(T, a, i)) {
+                return true;
             }
         }
+        return false;
     }
 }
@@ -1,10 +1,31 @@
 #pragma once
 
 #include <L3.h>
+#include <passes.h>
 
 namespace L3 {
 
-  void MergeTree(Program &p);
+  class MergeStats {
+    public:
+      int64_t dead = 0;           // trees removed as dead stores
+      int64_t merged = 0;         // trees grafted into their single user
+      int64_t dead_later = 0;     // of which found after the first round
+      int64_t merged_later = 0;
+      int64_t rounds = 0;         // most rounds a function took to settle
+      int64_t live_updates = 0;   // block transfers spent keeping liveness up to date
+  };
+
+  MergeStats MergeTree(Program &p, Analyses& a, int rounds);   // at most rounds of removing and merging
+
+  /* one round at -O1, to the fixpoint from -O2 */
+  class MergePass : public Pass {
+    public:
+      MergePass () : Pass ("merge", 1, {}, 0) {}
+
+      void run(Program& p, Analyses& a, int optLevel) override;
+
+      MergeStats stats;
+  };
 
 }
 
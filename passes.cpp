@@ -0,0 +1,109 @@
+#include <cassert>
+#include <algorithm>
+
+#include <passes.h>
+#include <report.h>
+
+namespace L3 {
+
+Analyses::Analyses (Program& p)
+  : p {p},
+    builds {0} {}
+
+CFG& Analyses::cfg(Function* f) {
+    auto& g = cfgs[f];
+    if (!g) {
+        g.reset(new CFG(p, f));
+        builds++;
+    }
+    return *g;
+}
+
+Liveness& Analyses::liveness(Function* f) {
+    auto& l = livenesses[f];
+    if (!l) {
+        l.reset(new Liveness(f, cfg(f)));
+        builds++;
+    }
+    return *l;
+}
+
+DomTree& Analyses::dominators(Function* f) {
+    auto& d = doms[f];
+    if (!d) {
+        d.reset(new DomTree(cfg(f)));
+        builds++;
+    }
+    return *d;
+}
+
+LoopForest& Analyses::loops(Function* f) {
+    auto& l = forests[f];
+    if (!l) {
+        l.reset(new LoopForest(dominators(f)));
+        builds++;
+    }
+    return *l;
+}
+
+void Analyses::invalidate(int kept) {
+    if (!(kept & CFG_ANALYSIS) || !(kept & DOM_ANALYSIS) || !(kept & LOOP_ANALYSIS)) {
+        forests.clear();
+    }
+    if (!(kept & CFG_ANALYSIS) || !(kept & LIVENESS_ANALYSIS)) {
+        livenesses.clear();
+    }
+    if (!(kept & CFG_ANALYSIS) || !(kept & DOM_ANALYSIS)) {
+        doms.clear();
+    }
+    if (!(kept & CFG_ANALYSIS)) {
+        cfgs.clear();
+    }
+}
+
+Pass* PassManager::find(const std::string& name) {
+    for (auto& pass : passes) {
+        if (pass->name == name) {
+            return pass.get();
+        }
+    }
+    return NULL;
+}
+
+void PassManager::pull(Pass* pass, std::vector<Pass*>& order, std::vector<Pass*>& visiting) {
+    if (std::find(order.begin(), order.end(), pass) != order.end()) {
+        return;
+    }
+    assert(std::find(visiting.begin(), visiting.end(), pass) == visiting.end() && "cyclic pass requirements");
+    visiting.push_back(pass);
+    for (auto& name : pass->depends) {
+        auto required = find(name);
+        assert(required && "required pass not registered");
+        pull(required, order, visiting);
+    }
+    visiting.pop_back();
+    order.push_back(pass);
+}
+
+std::vector<Pass*> PassManager::schedule() {
+    std::vector<Pass*> order;
+    std::vector<Pass*> visiting;
+    for (auto& pass : passes) {
+        if (pass->level <= optLevel) {
+            pull(pass.get(), order, visiting);
+        }
+    }
+    return order;
+}
+
+void PassManager::run(Program& p) {
+    Analyses a (p);
+    for (auto pass : schedule()) {
+        report.begin(pass->name);
+        pass->run(p, a, optLevel);
+        report.end();
+        a.invalidate(pass->preserves);
+    }
+}
+
+}
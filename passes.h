@@ -0,0 +1,89 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <L3.h>
+#include <cfg.h>
+#include <dom.h>
+#include <liveness.h>
+#include <loops.h>
+
+namespace L3 {
+
+  enum Analysis {CFG_ANALYSIS = 1, LIVENESS_ANALYSIS = 2, DOM_ANALYSIS = 4, LOOP_ANALYSIS = 8, ALL_ANALYSES = 15};
+
+  /*
+   * analyses of each function, built on first request and kept until a pass changes what they describe
+   *   the liveness and the dominators are solved on the cached CFG, dropping the CFG drops them too,
+   *   the loops are found on the cached dominators
+   */
+  class Analyses {
+    public:
+      Analyses (Program& p);
+
+      CFG& cfg(Function* f);
+      Liveness& liveness(Function* f);
+      DomTree& dominators(Function* f);
+      LoopForest& loops(Function* f);
+      void invalidate(int kept);          // drop every analysis not in kept, a mask of Analysis
+
+      Program& p;
+      int64_t builds;                     // analyses built so far
+
+    private:
+      std::map<Function*, std::unique_ptr<CFG>> cfgs;
+      std::map<Function*, std::unique_ptr<Liveness>> livenesses;
+      std::map<Function*, std::unique_ptr<DomTree>> doms;
+      std::map<Function*, std::unique_ptr<LoopForest>> forests;
+  };
+
+  /*
+   * a step of the compilation between parsing and code generation
+   *   level is the lowest -O level running it, depends names the passes to run before it, even below their level,
+   *   and preserves the analyses it leaves valid
+   */
+  class Pass {
+    public:
+      Pass (std::string name, int level, std::vector<std::string> depends, int preserves)
+        : name {name}, level {level}, depends {depends}, preserves {preserves} {}
+      virtual ~Pass () {}
+
+      virtual void run(Program& p, Analyses& a, int optLevel) = 0;
+
+      std::string name;
+      int level;
+      std::vector<std::string> depends;
+      int preserves;
+  };
+
+  /*
+   * runs the registered passes enabled at an -O level in the order they were added,
+   * a pass pulling in the passes it requires first
+   */
+  class PassManager {
+    public:
+      PassManager (int optLevel) : optLevel {optLevel} {}
+
+      template <typename P, typename... Args>
+      P* add(Args&&... args) {
+        auto pass = new P(std::forward<Args>(args)...);
+        passes.push_back(std::unique_ptr<Pass>(pass));
+        return pass;
+      }
+
+      std::vector<Pass*> schedule();
+      void run(Program& p);
+
+      int optLevel;
+
+    private:
+      Pass* find(const std::string& name);
+      void pull(Pass* pass, std::vector<Pass*>& order, std::vector<Pass*>& visiting);
+
+      std::vector<std::unique_ptr<Pass>> passes;
+  };
+
+}
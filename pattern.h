@@ -0,0 +1,108 @@
+#pragma once
+
+#include <L3.h>
+
+namespace L3 {
+
+  /*
+   * tree shapes and their rewrites declared as types, each one compiles to its own matcher
+   *   a Rule<Shape, Output> matches Shape at a node, binding nodes to slots, slot 0 is the node itself,
+   *   then builds Output from the slots, an Edit rewrites a bound node in place, anything else is created
+   *
+   *   Rule<Tree<Op::s_rn, Tree<Op::addn, Tree<Op::s_ln, Bind<1>, Const<1>>, Const<1>>, Const<1>>,
+   *        Edit<0, Op::asmt, Ref<1>>>
+   *     [ v <- ((a << 1) + 1) >> 1 ] --> [ v <- a ]
+   */
+  namespace pattern {
+
+    class Slots {
+      public:
+        Node at[8];
+    };
+
+    /* shapes */
+    class Any {
+      public:
+        static bool match(TreePool& T, Node i, Slots& s) { return true; }
+    };
+
+    template <int64_t N>
+    class Const {   // the constant N
+      public:
+        static bool match(TreePool& T, Node i, Slots& s) {
+          return T.op[i] == Op::leaf && T.root[i].type == NUM && T.root[i].getval() == N;
+        }
+    };
+
+    template <Op O>
+    class NotOp {   // any node but an O
+      public:
+        static bool match(TreePool& T, Node i, Slots& s) { return T.op[i] != O; }
+    };
+
+    template <Op O, typename L = Any, typename R = Any>
+    class Tree {    // an O node, R is the last leaf, the same as L for a single leaf
+      public:
+        static bool match(TreePool& T, Node i, Slots& s) {
+          return T.op[i] == O && L::match(T, T.left[i], s) && R::match(T, T.back(i), s);
+        }
+    };
+
+    template <int K, typename P = Any>
+    class Bind {
+      public:
+        static bool match(TreePool& T, Node i, Slots& s) {
+          s.at[K] = i;
+          return P::match(T, i, s);
+        }
+    };
+
+    /* outputs */
+    class None {
+      public:
+        static Node build(TreePool& T, Slots& s) { return NIL; }
+    };
+
+    template <int K>
+    class Ref {
+      public:
+        static Node build(TreePool& T, Slots& s) { return s.at[K]; }
+    };
+
+    template <int K, int64_t M>
+    class Scaled {  // a new constant, M times the one bound to K, wrapping around
+      public:
+        static Node build(TreePool& T, Slots& s) { return T.make(L3::Num(static_cast<uint64_t>(M) * T.root[s.at[K]].getval()), Op::leaf); }
+    };
+
+    template <int K, Op O, typename L, typename R = None>
+    class Edit {    // the node bound to K turned into an O node, its root item kept
+      public:
+        static Node build(TreePool& T, Slots& s) {
+          Node l = L::build(T, s);
+          Node r = R::build(T, s);
+          Node n = s.at[K];
+          T.op[n] = O;
+          T.left[n] = l;
+          T.right[n] = r;
+          return n;
+        }
+    };
+
+    template <typename Shape, typename Output>
+    class Rule {
+      public:
+        static bool apply(TreePool& T, Node i) {
+          Slots s;
+          s.at[0] = i;
+          if (!Shape::match(T, i, s)) {
+            return false;
+          }
+          Output::build(T, s);
+          return true;
+        }
+    };
+
+  }
+
+}
@@ -0,0 +1,147 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <sys/resource.h>
+
+#include <report.h>
+
+/* every allocation of the compiler goes through here, counting is two adds */
+static int64_t allocations = 0;
+static int64_t allocated = 0;
+
+void* operator new(std::size_t n) {
+    allocations++;
+    allocated += n;
+    if (auto p = std::malloc(n ? n : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+namespace L3 {
+
+Report report;
+
+Usage Usage::now() {
+    Usage u;
+    u.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    u.allocs = allocations;
+    u.bytes = allocated;
+    struct rusage r;
+    getrusage(RUSAGE_SELF, &r);
+    u.peak_rss = r.ru_maxrss;
+    return u;
+}
+
+Usage Usage::since(const Usage& start) const {
+    Usage u;
+    u.ms = ms - start.ms;
+    u.allocs = allocs - start.allocs;
+    u.bytes = bytes - start.bytes;
+    u.peak_rss = peak_rss;
+    return u;
+}
+
+void Report::begin(const std::string& phase) {
+    if (!enabled) {
+        return;
+    }
+    phases.push_back(PhaseReport());
+    phases.back().name = phase;
+    phase_start = Usage::now();
+}
+
+void Report::end() {
+    if (!enabled) {
+        return;
+    }
+    end_function();
+    phases.back().usage = Usage::now().since(phase_start);
+}
+
+void Report::begin_function(const std::string& name) {
+    if (!enabled) {
+        return;
+    }
+    end_function();
+    function = name;
+    in_function = true;
+    function_start = Usage::now();
+}
+
+void Report::end_function() {
+    if (!enabled || !in_function) {
+        return;
+    }
+    phases.back().functions.push_back({function, Usage::now().since(function_start)});
+    in_function = false;
+}
+
+static void row(std::ostream& out, const std::string& name, const Usage& u) {
+    char line[160];
+    std::snprintf(line, sizeof(line), "%-24s %12.3f %12lld %12lld %12lld\n", name.c_str(), u.ms,
+                  (long long)u.allocs, (long long)(u.bytes >> 10), (long long)u.peak_rss);
+    out << line;
+}
+
+void Report::print(std::ostream& out) {
+    Usage total;
+    out << "phase / function                   ms       allocs     alloc KB  peak RSS KB\n";
+    for (auto& phase : phases) {
+        row(out, phase.name, phase.usage);
+        for (auto& f : phase.functions) {
+            row(out, "  " + f.first, f.second);
+        }
+        total.ms += phase.usage.ms;
+        total.allocs += phase.usage.allocs;
+        total.bytes += phase.usage.bytes;
+        total.peak_rss = phase.usage.peak_rss;
+    }
+    row(out, "total", total);
+}
+
+static std::string quoted(const std::string& s) {
+    std::string q = "\"";
+    for (auto c : s) {
+        if (c == '"' || c == '\\') {
+            q += '\\';
+        }
+        q += c;
+    }
+    return q + "\"";
+}
+
+static void fields(std::ostream& out, const Usage& u) {
+    char line[160];
+    std::snprintf(line, sizeof(line), "\"ms\": %.3f, \"allocs\": %lld, \"bytes\": %lld, \"peak_rss_kb\": %lld",
+                  u.ms, (long long)u.allocs, (long long)u.bytes, (long long)u.peak_rss);
+    out << line;
+}
+
+void Report::json(std::ostream& out) {
+    out << "{\"phases\": [";
+    for (int k = 0; k < (int)phases.size(); k++) {
+        auto& phase = phases[k];
+        out << (k ? ",\n  " : "\n  ") << "{\"name\": " << quoted(phase.name) << ", ";
+        fields(out, phase.usage);
+        out << ", \"functions\": [";
+        for (int i = 0; i < (int)phase.functions.size(); i++) {
+            out << (i ? ", " : "") << "{\"name\": " << quoted(phase.functions[i].first) << ", ";
+            fields(out, phase.functions[i].second);
+            out << "}";
+        }
+        out << "]}";
+    }
+    out << "\n]}\n";
+}
+
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace L3 {
+
+  /* what the process spent up to some point, or between two points */
+  class Usage {
+    public:
+      static Usage now();
+      Usage since(const Usage& start) const;   // peak_rss stays the peak reached at the later point
+
+      double ms = 0;          // wall time
+      int64_t allocs = 0;     // calls to operator new
+      int64_t bytes = 0;      // bytes they asked for
+      int64_t peak_rss = 0;   // KB
+  };
+
+  class PhaseReport {
+    public:
+      std::string name;
+      Usage usage;
+      std::vector<std::pair<std::string, Usage>> functions;
+  };
+
+  /*
+   * time and memory spent by each phase of the compilation, as a whole and per function
+   *   the driver and the pass manager open the phases, the phases mark the functions they walk,
+   *   nothing is measured unless enabled
+   */
+  class Report {
+    public:
+      void begin(const std::string& phase);
+      void end();
+      void begin_function(const std::string& name);
+      void end_function();                     // nothing when no function is open
+
+      void print(std::ostream& out);
+      void json(std::ostream& out);
+
+      bool enabled = false;
+      std::vector<PhaseReport> phases;
+
+    private:
+      Usage phase_start;
+      Usage function_start;
+      std::string function;
+      bool in_function = false;
+  };
+
+  extern Report report;
+
+}
@@ -0,0 +1,539 @@
+#include <algorithm>
+
+#include <sccp.h>
+#include <report.h>
+
+namespace L3 {
+
+    /* what a value is known to be, TOP until some path writing it runs */
+    class Lattice {
+      public:
+        enum State {TOP, CONST, BOTTOM};
+
+        static Lattice Const(int64_t n) { Lattice l; l.state = CONST; l.n = n; return l; }
+        static Lattice Bottom() { Lattice l; l.state = BOTTOM; return l; }
+
+        Lattice meet(const Lattice& o) const {
+            if (state == TOP || o.state == BOTTOM) {
+                return o;
+            }
+            if (o.state == TOP || state == BOTTOM || n == o.n) {
+                return *this;
+            }
+            return Bottom();
+        }
+        bool operator!= (const Lattice& o) const { return state != o.state || (state == CONST && n != o.n); }
+
+        State state = TOP;
+        int64_t n = 0;
+    };
+
+    /* a var joined at the start of a block, with the value it has on the edge from each predecessor */
+    class Phi {
+      public:
+        int var;
+        int block;
+        int value;
+        int in;   // first of its inputs, in the order of the predecessors of the block
+    };
+
+    /*
+     * sparse conditional constant propagation of a function (Wegman, Zadeck) on semi-pruned SSA
+     *   each var a tree writes and each phi is a value, each var leaf reads one, value 0 standing for the function entry,
+     *   only the vars some block reads before writing them get phis
+     *   a tree is evaluated once its block ran and again when a value it reads changed,
+     *   a phi only meets the edges taken so far
+     */
+    class Sccp {
+      public:
+        Sccp (Program& p, Function* f, CFG& g, DomTree& D, SccpStats& stats);
+
+        void solve();
+        void rewrite();
+
+      private:
+        void place();
+        void rename();
+        void rename(Node t, std::vector<int>& cur, std::vector<std::pair<int, int>>& undo);
+        void reads();
+
+        Lattice eval(Node i);
+        void lower(int value, const Lattice& l);
+        void update(Node t);
+        void join(int input);
+        void enter(int b, int e);
+        int edge(int from, int to) const;
+        void substitute(Node i);
+
+        Program& p;
+        Function* f;
+        TreePool& T;
+        CFG& g;
+        DomTree& D;
+        SccpStats& stats;
+
+        std::vector<int> ssa;         // value of each var leaf and of each node writing a var
+        std::vector<Lattice> values;
+        std::vector<Phi> phis;
+        std::vector<int> inputs;      // values of the phis on each edge into their block
+        std::vector<int> owner;       // phi of each input
+        std::vector<std::vector<int>> phis_at;
+        std::vector<int> uses;        // trees then phi inputs, complemented, reading each value, from first_use to first_use of the next value
+        std::vector<int> first_use;
+        std::vector<Node> stack;
+        std::vector<Node> order;
+
+        std::vector<bool> ran;
+        std::vector<std::vector<bool>> taken;   // edges into each block taken so far, in the order of its predecessors
+        std::vector<std::pair<int, int>> flow;
+        std::vector<int> work;
+    };
+
+    /* the vars read by node i before block b writes them */
+    static void Exposed(TreePool& T, Node i, int b, std::vector<int>& written, std::vector<bool>& exposed) {
+        for (int k = 0; k < T.size(i); k++) {
+            Node c = T.leaf(i, k);
+            if (T.op[c] != Op::leaf) {
+                Exposed(T, c, b, written, exposed);
+            } else if (T.root[c].type == VAR && written[T.root[c].getval()] != b) {
+                exposed[T.root[c].getval()] = true;
+            }
+        }
+    }
+
+    /* the vars node i writes, with the blocks writing each */
+    static void Written(TreePool& T, Node i, int b, std::vector<int>& written, std::vector<std::vector<int>>& blocks) {
+        if (T.op[i] == Op::leaf) {
+            return;
+        }
+        if (T.root[i].type == VAR) {
+            int v = T.root[i].getval();
+            if (written[v] != b) {
+                written[v] = b;
+                blocks[v].push_back(b);
+            }
+        }
+        for (int k = 0; k < T.size(i); k++) {
+            Written(T, T.leaf(i, k), b, written, blocks);
+        }
+    }
+
+    Sccp::Sccp (Program& p, Function* f, CFG& g, DomTree& D, SccpStats& stats)
+      : p {p},
+        f {f},
+        T {f->trees},
+        g {g},
+        D {D},
+        stats {stats},
+        ssa (f->trees.root.size(), 0),
+        values (1, Lattice::Bottom()),
+        phis_at (g.blocks()),
+        ran (g.blocks(), false),
+        taken (g.blocks()) {
+        for (int b = 0; b < g.blocks(); b++) {
+            taken[b].assign(g.pred[b].size(), false);
+        }
+        place();
+        rename();
+        reads();
+    }
+
+    /* phis on the iterated dominance frontier of the blocks writing each var read across blocks */
+    void Sccp::place() {
+        int n = g.blocks();
+        std::vector<bool> exposed (f->var_count + 1, false);
+        std::vector<int> written (f->var_count + 1, -1);
+        std::vector<std::vector<int>> blocks (f->var_count + 1);
+        for (int b = 0; b < n; b++) {
+            for (int i = g.first[b]; i <= g.last[b]; i++) {
+                if (g.inst[i] != NIL) {
+                    Exposed(T, g.inst[i], b, written, exposed);
+                    Written(T, g.inst[i], b, written, blocks);
+                }
+            }
+        }
+
+        std::vector<int> placed (n, 0);
+        std::vector<int> added (n, 0);
+        std::vector<int> todo;
+        for (int v = 1; v <= f->var_count; v++) {
+            if (!exposed[v]) {
+                continue;
+            }
+            todo = blocks[v];
+            for (auto b : todo) {
+                added[b] = v;
+            }
+            while (!todo.empty()) {
+                int b = todo.back();
+                todo.pop_back();
+                for (auto y : D.frontier[b]) {
+                    if (placed[y] == v) {
+                        continue;
+                    }
+                    placed[y] = v;
+                    Phi phi;
+                    phi.var = v;
+                    phi.block = y;
+                    phi.value = values.size();
+                    phi.in = inputs.size();
+                    inputs.resize(inputs.size() + g.pred[y].size(), 0);
+                    owner.resize(inputs.size(), phis.size());
+                    values.push_back(Lattice());
+                    phis_at[y].push_back(phis.size());
+                    phis.push_back(phi);
+                    if (added[y] != v) {
+                        added[y] = v;
+                        todo.push_back(y);
+                    }
+                }
+            }
+        }
+        stats.phis += phis.size();
+    }
+
+    /* the values the var leaves of tree t read, then the values it writes, the trees merged into it before its root */
+    void Sccp::rename(Node t, std::vector<int>& cur, std::vector<std::pair<int, int>>& undo) {
+        order.clear();
+        stack.push_back(t);
+        while (!stack.empty()) {
+            auto j = stack.back();
+            stack.pop_back();
+            if (T.op[j] == Op::leaf) {
+                if (T.root[j].type == VAR) {
+                    ssa[j] = cur[T.root[j].getval()];
+                }
+                continue;
+            }
+            order.push_back(j);
+            for (int k = 0; k < T.size(j); k++) {
+                stack.push_back(T.leaf(j, k));
+            }
+        }
+        for (auto it = order.rbegin(); it != order.rend(); ++it) {
+            if (T.root[*it].type == VAR) {
+                int v = T.root[*it].getval();
+                ssa[*it] = values.size();
+                values.push_back(Lattice());
+                undo.push_back({v, cur[v]});
+                cur[v] = ssa[*it];
+            }
+        }
+    }
+
+    /* down the dominator tree, each var read being the value last written above it */
+    void Sccp::rename() {
+        std::vector<int> cur (f->var_count + 1, 0);
+        std::vector<std::pair<int, int>> undo;
+        std::vector<std::pair<int, int>> walk;   // block, and once its subtree is done the undo mark to return to
+        walk.push_back({0, -1});
+        while (!walk.empty()) {
+            auto top = walk.back();
+            walk.pop_back();
+            if (top.second >= 0) {
+                for (; (int)undo.size() > top.second; undo.pop_back()) {
+                    cur[undo.back().first] = undo.back().second;
+                }
+                continue;
+            }
+            int b = top.first;
+            walk.push_back({b, (int)undo.size()});
+            for (auto k : phis_at[b]) {
+                undo.push_back({phis[k].var, cur[phis[k].var]});
+                cur[phis[k].var] = phis[k].value;
+            }
+            for (int i = g.first[b]; i <= g.last[b]; i++) {
+                if (g.inst[i] != NIL) {
+                    rename(g.inst[i], cur, undo);
+                }
+            }
+            for (auto s : g.succ[b]) {
+                int e = edge(b, s);
+                for (auto k : phis_at[s]) {
+                    inputs[phis[k].in + e] = cur[phis[k].var];
+                }
+            }
+            for (auto c : D.children[b]) {
+                walk.push_back({c, -1});
+            }
+        }
+    }
+
+    /* the trees whose var leaves read each value, a tree reading it twice listed twice, then the phi inputs taking it */
+    void Sccp::reads() {
+        int n = values.size();
+        first_use.assign(n + 1, 0);
+        auto each = [&](auto use) {
+            for (int i = 0; i < g.size; i++) {
+                if (g.inst[i] == NIL) {
+                    continue;
+                }
+                stack.push_back(g.inst[i]);
+                while (!stack.empty()) {
+                    auto j = stack.back();
+                    stack.pop_back();
+                    if (T.op[j] != Op::leaf) {
+                        for (int k = 0; k < T.size(j); k++) {
+                            stack.push_back(T.leaf(j, k));
+                        }
+                    } else if (T.root[j].type == VAR) {
+                        use(ssa[j], g.inst[i]);
+                    }
+                }
+            }
+            for (int k = 0; k < (int)inputs.size(); k++) {
+                use(inputs[k], ~k);
+            }
+        };
+        each([&](int v, int u) { first_use[v + 1]++; });
+        for (int v = 0; v < n; v++) {
+            first_use[v + 1] += first_use[v];
+        }
+        uses.resize(first_use[n]);
+        auto next = first_use;
+        each([&](int v, int u) { uses[next[v]++] = u; });
+    }
+
+    int Sccp::edge(int from, int to) const {
+        return std::find(g.pred[to].begin(), g.pred[to].end(), from) - g.pred[to].begin();
+    }
+
+    Lattice Sccp::eval(Node i) {
+        auto op = T.op[i];
+        if (op == Op::leaf) {
+            auto it = T.root[i];
+            return it.type == NUM ? Lattice::Const(it.getval()) : it.type == VAR ? values[ssa[i]] : Lattice::Bottom();
+        }
+        if (op == Op::asmt) {
+            return eval(T.left[i]);
+        }
+        if (op > Op::asmt) {   // loads and calls
+            return Lattice::Bottom();
+        }
+        auto l = eval(T.left[i]);
+        auto r = eval(T.back(i));
+        if (l.state == Lattice::BOTTOM || r.state == Lattice::BOTTOM) {
+            return Lattice::Bottom();
+        }
+        if (l.state == Lattice::TOP || r.state == Lattice::TOP) {
+            return Lattice();
+        }
+        return Lattice::Const(arithmetic(l.n, r.n, op));
+    }
+
+    void Sccp::lower(int value, const Lattice& l) {
+        if (values[value] != l) {
+            values[value] = l;
+            work.push_back(value);
+        }
+    }
+
+    /* the values tree t writes, and the edges a cjump takes with what its condition is known to be */
+    void Sccp::update(Node t) {
+        stats.evaluations++;
+        stack.push_back(t);
+        while (!stack.empty()) {
+            auto j = stack.back();
+            stack.pop_back();
+            if (T.op[j] == Op::leaf) {
+                continue;
+            }
+            if (T.root[j].type == VAR) {
+                lower(ssa[j], eval(j));
+            }
+            for (int k = 0; k < T.size(j); k++) {
+                stack.push_back(T.leaf(j, k));
+            }
+        }
+        if (T.op[t] == Op::cjmp) {
+            int b = g.block_of[T.id_in_func[t]];
+            int target = g.block_of[f->label_id_map.find(T.root[t].getval())->second];
+            auto c = eval(T.left[t]);
+            for (auto s : g.succ[b]) {
+                if (c.state == Lattice::BOTTOM || (c.state == Lattice::CONST && (c.n == 1 ? s == target : s == b + 1))) {
+                    flow.push_back({b, s});
+                }
+            }
+        }
+    }
+
+    /* values only go down, a phi meets what it is with an input that went down or came in through a new edge */
+    void Sccp::join(int input) {
+        auto& phi = phis[owner[input]];
+        if (taken[phi.block][input - phi.in]) {
+            stats.evaluations++;
+            lower(phi.value, values[phi.value].meet(values[inputs[input]]));
+        }
+    }
+
+    /* block b entered through its edge e, or from the function entry when e is -1, which brings no constant,
+       the trees run the first time only, a value they read changing runs them again */
+    void Sccp::enter(int b, int e) {
+        for (auto k : phis_at[b]) {
+            if (e < 0) {
+                lower(phis[k].value, Lattice::Bottom());
+            } else {
+                join(phis[k].in + e);
+            }
+        }
+        if (ran[b]) {
+            return;
+        }
+        ran[b] = true;
+        for (int i = g.first[b]; i <= g.last[b]; i++) {
+            if (g.inst[i] != NIL) {
+                update(g.inst[i]);
+            }
+        }
+        auto t = g.inst[g.last[b]];
+        if (t == NIL || T.op[t] != Op::cjmp) {
+            for (auto s : g.succ[b]) {
+                flow.push_back({b, s});
+            }
+        }
+    }
+
+    void Sccp::solve() {
+        enter(0, -1);
+        while (!flow.empty() || !work.empty()) {
+            if (!flow.empty()) {
+                auto e = flow.back();
+                flow.pop_back();
+                int k = edge(e.first, e.second);
+                if (!taken[e.second][k]) {
+                    taken[e.second][k] = true;
+                    enter(e.second, k);
+                }
+                continue;
+            }
+            int v = work.back();
+            work.pop_back();
+            for (int u = first_use[v]; u < first_use[v + 1]; u++) {
+                int t = uses[u];
+                if (t < 0) {
+                    join(~t);
+                } else if (t >= 0 && ran[g.block_of[T.id_in_func[t]]]) {
+                    update(t);
+                }
+            }
+        }
+    }
+
+    /* the reads below node i of a constant become the constant, but for the slots taking a var */
+    void Sccp::substitute(Node i) {
+        int n = T.size(i);
+        for (int k = 0; k < n; k++) {
+            Node c = T.leaf(i, k);
+            if (T.op[c] != Op::leaf) {
+                substitute(c);
+                continue;
+            }
+            bool var = (k == 0 && (T.op[i] == Op::load || T.op[i] == Op::store)) || (T.op[i] == Op::call && k == n - 1);
+            if (!var && T.root[c].type == VAR && values[ssa[c]].state == Lattice::CONST) {
+                T.root[c] = Num(values[ssa[c]].n);
+                stats.constants++;
+            }
+        }
+    }
+
+    /* labels written by the trees, jumped to, returned to or held as a value */
+    static void References(TreePool& T, Node i, std::vector<bool>& referenced) {
+        if (T.op[i] != Op::label && T.root[i].type == LABEL) {
+            referenced[T.root[i].getval()] = true;
+        }
+        if (T.op[i] != Op::leaf) {
+            for (int k = 0; k < T.size(i); k++) {
+                References(T, T.leaf(i, k), referenced);
+            }
+        }
+    }
+
+    /* constants into the reads, known branches folded, blocks that never run and labels nothing refers to removed */
+    void Sccp::rewrite() {
+        std::vector<bool> removed (g.size, false);
+        for (int b = 0; b < g.blocks(); b++) {
+            for (int i = g.first[b]; i <= g.last[b]; i++) {
+                auto t = g.inst[i];
+                if (t == NIL) {
+                    continue;
+                }
+                if (!ran[b]) {
+                    if (T.op[t] != Op::label) {
+                        removed[i] = true;
+                        stats.unreachable++;
+                    }
+                    continue;
+                }
+                auto c = T.op[t] == Op::cjmp ? eval(T.left[t]) : Lattice();
+                if (c.state == Lattice::CONST) {
+                    if (c.n == 1) {   // the branch is taken on 1 only, as cjump t = 1
+                        T.op[t] = Op::br;
+                        T.left[t] = NIL;
+                        stats.gotos++;
+                    } else {
+                        removed[i] = true;
+                        stats.dropped++;
+                    }
+                    continue;
+                }
+                substitute(t);
+            }
+        }
+
+        std::vector<bool> referenced (p.global_label_count + 1, false);
+        for (int i = 0; i < g.size; i++) {
+            if (g.inst[i] != NIL && !removed[i]) {
+                References(T, g.inst[i], referenced);
+            }
+        }
+        for (int i = 0; i < g.size; i++) {
+            auto t = g.inst[i];
+            if (t != NIL && T.op[t] == Op::label && !referenced[T.root[t].getval()]) {
+                removed[i] = true;
+                stats.labels++;
+            }
+        }
+
+        /* the contexts left, joined where a removed label or branch was all that split them */
+        std::vector<Context*> contexts;
+        for (auto c : f->contexts) {
+            int k = 0;
+            for (auto t : c->trees) {
+                if (!removed[T.id_in_func[t]]) {
+                    c->trees[k++] = t;
+                }
+            }
+            c->trees.resize(k);
+            if (c->trees.empty()) {
+                continue;
+            }
+            if (Joins(T, contexts, c->trees.front())) {
+                auto& prev = contexts.back()->trees;
+                prev.insert(prev.end(), c->trees.begin(), c->trees.end());
+                continue;
+            }
+            contexts.push_back(c);
+        }
+        f->contexts = contexts;
+    }
+
+    SccpStats PropagateConstants(Program& p, Analyses& a) {
+        SccpStats stats;
+        for (auto f : p.functions) {
+            report.begin_function(f->name);
+            auto& g = a.cfg(f);
+            if (g.blocks() > 0) {
+                Sccp s (p, f, g, a.dominators(f), stats);
+                s.solve();
+                s.rewrite();
+            }
+            report.end_function();
+        }
+        return stats;
+    }
+
+    void SccpPass::run(Program& p, Analyses& a, int optLevel) {
+        stats = PropagateConstants(p, a);
+    }
+
+}
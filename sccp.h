@@ -0,0 +1,35 @@
+#pragma once
+
+#include <L3.h>
+#include <passes.h>
+
+namespace L3 {
+
+  class SccpStats {
+    public:
+      int64_t constants = 0;    // var reads replaced by the constant the var holds there
+      int64_t gotos = 0;        // conditional branches always taken, turned into gotos
+      int64_t dropped = 0;      // conditional branches never taken, removed
+      int64_t unreachable = 0;  // trees removed as never executed
+      int64_t labels = 0;       // labels removed as no longer referenced
+      int64_t phis = 0;         // vars joined at the start of a block
+      int64_t evaluations = 0;  // trees and phis evaluated until the values settled
+  };
+
+  SccpStats PropagateConstants(Program& p, Analyses& a);
+
+  /*
+   * sparse conditional constant propagation on the SSA form of each function, ahead of merging
+   *   a block is only entered through the edges its predecessors can take with the constants known so far,
+   *   the reads of constants become the constants, which leaves their assignments to the dead store removal of the merge
+   */
+  class SccpPass : public Pass {
+    public:
+      SccpPass () : Pass ("sccp", 1, {}, 0) {}
+
+      void run(Program& p, Analyses& a, int optLevel) override;
+
+      SccpStats stats;
+  };
+
+}
@@ -0,0 +1,10 @@
+#!/bin/bash
+# allocs.sh COMPILER FILE [FLAGS...] : malloc calls and peak RSS of compiling FILE, with or without -v in the build
+#   the compiler's own -j report gives the same per phase: python3 phases.py COMPILER -r 1 FILE -- FLAGS
+#   the large input of the measurements is python3 tests/gen.py 1 3100, about 300k lines
+here=$(cd "$(dirname "$0")" && pwd)
+comp=$(realpath "$1"); file=$(realpath "$2"); shift 2
+work=$(mktemp -d)
+trap 'rm -rf $work' EXIT
+gcc -O2 -shared -fPIC $here/malloc_count.c -o $work/malloc_count.so || exit 1
+cd $work && LD_PRELOAD=$work/malloc_count.so $comp "$@" $file 2>&1 >/dev/null | grep '^mallocs='
@@ -0,0 +1,20 @@
+# one function with V vars kept live across a loop of N instructions, a branch every 50 of them
+#   python3 gen_live.py V N
+import random, sys
+
+V = int(sys.argv[1]); N = int(sys.argv[2])
+r = random.Random(5)
+o = ['define @main () {']
+for i in range(V):
+    o.append(' %%v%d <- %d' % (i, i))
+o += [' %k <- 0', ' :top']
+for n in range(N):
+    if n % 50 == 49:
+        o += [' %%c <- %%v%d < %%v%d' % (r.randrange(V), r.randrange(V)), ' br %%c :s%d' % n, ' :s%d' % n]
+    else:
+        o.append(' %%v%d <- %%v%d + %%v%d' % (r.randrange(V), r.randrange(V), r.randrange(V)))
+o += [' %k <- %k + 1', ' %c <- %k < 3', ' br %c :top', ' %s <- 0']
+for i in range(V):
+    o.append(' %%s <- %%s + %%v%d' % i)
+o += [' %s <- %s << 1', ' %s <- %s + 1', ' call print(%s)', ' return', '}']
+print('\n'.join(o))
@@ -0,0 +1,23 @@
+# D nested loops, each level with B straight-line instructions over V vars on the way in and on the way out
+#   python3 gen_loops.py D B V
+import random, sys
+
+D = int(sys.argv[1]); B = int(sys.argv[2]); V = int(sys.argv[3])
+r = random.Random(9)
+o = ['define @main () {']
+for i in range(V):
+    o.append(' %%v%d <- %d' % (i, i))
+def body():
+    for _ in range(B):
+        o.append(' %%v%d <- %%v%d + %%v%d' % (r.randrange(V), r.randrange(V), r.randrange(V)))
+for d in range(D):
+    o += [' %%k%d <- 0' % d, ' :h%d' % d]
+    body()
+for d in reversed(range(D)):
+    body()
+    o += [' %%k%d <- %%k%d + 1' % (d, d), ' %%c <- %%k%d < 2' % d, ' br %%c :h%d' % d]
+o.append(' %s <- 0')
+for i in range(V):
+    o.append(' %%s <- %%s + %%v%d' % i)
+o += [' %s <- %s << 1', ' %s <- %s + 1', ' call print(%s)', ' return', '}']
+print('\n'.join(o))
@@ -0,0 +1,30 @@
+# one context of N straight-line instructions over V vars: dense redefinitions, self updates and merge chains
+#   python3 gen_straight.py SEED N V
+import random, sys
+
+seed = int(sys.argv[1]); N = int(sys.argv[2]); V = int(sys.argv[3])
+r = random.Random(seed)
+vs = ['%%a%d' % i for i in range(V)]
+o = ['define @main () {']
+for v in vs:
+    o.append(' %s <- %d' % (v, r.randint(1, 9)))
+o.append(' %m <- call allocate(5, 1)')
+t = lambda: r.choice(vs) if r.random() < 0.8 else str(r.randint(0, 5))
+for _ in range(N):
+    k = r.random(); d = r.choice(vs)
+    if k < 0.5:
+        o.append(' %s <- %s %s %s' % (d, t(), r.choice(['+', '-', '*', '&', '<', '<=', '=']), t()))
+    elif k < 0.65:
+        o.append(' %s <- %s %s %d' % (d, r.choice(vs), r.choice(['<<', '>>']), r.randint(0, 3)))
+    elif k < 0.8:
+        o.append(' %s <- %s' % (d, t()))
+    elif k < 0.88:
+        o.append(' %s <- %s + 1' % (d, d))
+    elif k < 0.94:
+        o += [' %%p <- %%m + %d' % (8 * r.randint(1, 2)), ' store %%p <- %s' % r.choice(vs)]
+    else:
+        o += [' %%p <- %%m + %d' % (8 * r.randint(1, 2)), ' %s <- load %%p' % d]
+for v in vs:
+    o += [' %%z <- %s << 1' % v, ' %z <- %z + 1', ' call print(%z)']
+o += [' return', '}']
+print('\n'.join(o))
@@ -0,0 +1,12 @@
+# N temporaries defined up front and read back only at the end of the same context
+#   python3 gen_temps.py N
+import sys
+
+N = int(sys.argv[1])
+o = ['define @main () {', ' %a <- 3', ' %s <- 0']
+for k in range(N):
+    o.append(' %%t%d <- %%a + %d' % (k, k))
+for k in range(N):
+    o.append(' %%s <- %%s + %%t%d' % k)
+o += [' %s <- %s << 1', ' %s <- %s + 1', ' call print(%s)', ' return', '}']
+print('\n'.join(o))
@@ -0,0 +1,26 @@
+#!/bin/bash
+# instructions.sh COMPILER_A COMPILER_B FILE... [-- FLAGS...] : L2 instructions each compiler emits for each file, and the totals
+#   the greedy first-match cover is the build of the commit before "Choose tiles by minimum cost with a bottom-up labeler",
+#   e.g. git archive <that commit> | tar -x -C /tmp/greedy, built like the compiler
+#   an instruction is a line of prog.L2 other than the parentheses, the arg counts and the labels
+a=$(realpath "$1"); b=$(realpath "$2"); shift 2
+files=(); flags=()
+while [ $# -gt 0 ]; do
+  if [ "$1" = "--" ]; then shift; flags=("$@"); break; fi
+  files+=("$(realpath "$1")"); shift
+done
+work=$(mktemp -d)
+trap 'rm -rf $work' EXIT
+count() {
+  rm -f $work/prog.L2
+  (cd $work && timeout 60 $1 "${flags[@]}" $2 > /dev/null 2>&1) || { echo -1; return; }
+  grep -cvE '^\s*(\(.*|\)|[0-9]+|:[A-Za-z_0-9]+)\s*$' $work/prog.L2
+}
+ta=0; tb=0
+printf '%-30s %10s %10s\n' file A B
+for f in "${files[@]}"; do
+  x=$(count $a $f); y=$(count $b $f)
+  ta=$((ta + x)); tb=$((tb + y))
+  [ $x -ne $y ] || [ ${#files[@]} -le 20 ] && printf '%-30s %10d %10d\n' $(basename $f) $x $y
+done
+printf '%-30s %10d %10d\n' total $ta $tb
@@ -0,0 +1,11 @@
+#!/bin/bash
+# live_vars.sh COMPILER [RUNS] : merge time, which solves and updates the liveness, of functions with thousands of vars
+# live across a long loop, and of the large generated input with up to a few thousand vars per function
+here=$(cd "$(dirname "$0")" && pwd)
+comp=$1; runs=${2:-5}
+work=$(mktemp -d)
+trap 'rm -rf $work' EXIT
+python3 $here/gen_live.py 1000 5000 > $work/live_1000x5000.L3
+python3 $here/gen_live.py 4000 20000 > $work/live_4000x20000.L3
+python3 $here/../gen.py 1 3100 > $work/large.L3
+python3 $here/phases.py $comp -r $runs -p merge $work/live_1000x5000.L3 $work/live_4000x20000.L3 $work/large.L3 -- -O 1
@@ -0,0 +1,24 @@
+/*
+ * malloc calls and peak RSS of a whole run, for builds of the compiler without -v
+ *   gcc -O2 -shared -fPIC malloc_count.c -o malloc_count.so
+ *   LD_PRELOAD=./malloc_count.so COMPILER FILE    prints mallocs=... maxrss_kb=... on stderr at exit
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+extern void* __libc_malloc(size_t);
+
+static unsigned long long calls;
+
+void* malloc(size_t size) {
+    calls++;
+    return __libc_malloc(size);
+}
+
+__attribute__((destructor)) static void report(void) {
+    struct rusage r;
+    getrusage(RUSAGE_SELF, &r);
+    fprintf(stderr, "mallocs=%llu maxrss_kb=%ld\n", calls, r.ru_maxrss);
+}
@@ -0,0 +1,18 @@
+#!/bin/bash
+# merge_scaling.sh COMPILER [RUNS] : merge time of long straight-line contexts as they grow 4 times at each step,
+# which grows about 4 times as well when dead-tree removal and merging are linear in the size of a context
+#   temps N: N temporaries defined up front and read at the end of the context
+#   straight N: N random instructions over 50 vars
+here=$(cd "$(dirname "$0")" && pwd)
+comp=$1; runs=${2:-5}
+work=$(mktemp -d)
+trap 'rm -rf $work' EXIT
+for n in 5000 20000 80000; do
+  python3 $here/gen_temps.py $n > $work/temps_$n.L3
+done
+for n in 10000 40000 160000; do
+  python3 $here/gen_straight.py 1 $n 50 > $work/straight_$n.L3
+done
+python3 $here/phases.py $comp -r $runs -p merge $work/temps_{5000,20000,80000}.L3 $work/straight_{10000,40000,160000}.L3 -- -O 1 |
+  awk 'NR == 1 { printf "%-20s %10s %10s\n", $1, "merge ms", "us/inst"; next }
+       { n = $1; sub(/^[a-z]*_/, "", n); sub(/\.L3$/, "", n); printf "%-20s %10.3f %10.3f\n", $1, $3, 1000 * $3 / n }'
@@ -0,0 +1,42 @@
+# time, allocations and peak RSS of each phase of the compiler, the best of several runs of its -j report
+#   python3 phases.py COMPILER [-r RUNS] [-p PHASE] FILE... [-- FLAGS...]
+#   one line per file and phase, or for PHASE alone, the total last: best ms, allocs and bytes of that run, peak RSS
+#   the peak RSS is getrusage's, which starts at the RSS of this script where it forks the compiler, about 12 MB
+import json, os, subprocess, sys, tempfile
+
+def main():
+    args = sys.argv[1:]
+    flags = []
+    if '--' in args:
+        flags = args[args.index('--') + 1:]
+        args = args[:args.index('--')]
+    comp = os.path.abspath(args.pop(0))
+    runs = 7
+    only = None
+    files = []
+    while args:
+        a = args.pop(0)
+        if a == '-r':
+            runs = int(args.pop(0))
+        elif a == '-p':
+            only = args.pop(0)
+        else:
+            files.append(os.path.abspath(a))
+    work = tempfile.mkdtemp()
+    print('%-28s %-8s %10s %12s %14s %10s' % ('file', 'phase', 'ms', 'allocs', 'bytes', 'rss kb'))
+    for f in files:
+        best = {}
+        for _ in range(runs):
+            out = subprocess.run([comp, '-j'] + flags + [f], cwd=work, stdout=subprocess.PIPE, stderr=subprocess.DEVNULL, check=True).stdout
+            phases = json.loads(out)['phases']
+            total = {'name': 'total', 'ms': sum(p['ms'] for p in phases), 'allocs': sum(p['allocs'] for p in phases),
+                     'bytes': sum(p['bytes'] for p in phases), 'peak_rss_kb': max(p['peak_rss_kb'] for p in phases)}
+            for p in phases + [total]:
+                if p['name'] not in best or p['ms'] < best[p['name']]['ms']:
+                    best[p['name']] = p
+        for name, p in best.items():
+            if only is None or name == only:
+                print('%-28s %-8s %10.3f %12d %14d %10d' % (os.path.basename(f), name, p['ms'], p['allocs'], p['bytes'], p['peak_rss_kb']))
+    subprocess.run(['rm', '-rf', work])
+
+main()
@@ -0,0 +1,14 @@
+#!/bin/bash
+# tiling.sh COMPILER [RUNS] : best tile-phase time of RUNS compilations at -O0 and -O2
+# of the large generated input, a long straight-line context and nested loops
+here=$(cd "$(dirname "$0")" && pwd)
+comp=$1; runs=${2:-7}
+work=$(mktemp -d)
+trap 'rm -rf $work' EXIT
+python3 $here/../gen.py 1 3100 > $work/large.L3
+python3 $here/gen_straight.py 1 40000 50 > $work/straight.L3
+python3 $here/gen_loops.py 8 600 60 > $work/loops.L3
+for o in 0 2; do
+  echo "-O$o"
+  python3 $here/phases.py $comp -r $runs -p tile $work/large.L3 $work/straight.L3 $work/loops.L3 -- -O $o
+done
@@ -0,0 +1,54 @@
+/*
+ * tree walking microbenchmark: 50 recursive walks over every tree of a program, reading and comparing
+ * the item of each root and leaf, timed RUNS times, the median and the best run printed
+ *   g++ -std=c++20 -O2 -I<PEGTL>/include -I. $(ls *.cpp | grep -v compiler.cpp) tests/bench/walk.cpp -o walk
+ *   walk FILE [RUNS]
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <L3parser.h>
+
+using namespace L3;
+
+static int64_t sum;
+static int64_t same;
+
+static void Walk(TreePool& T, Node t) {
+    auto r = T.root[t];
+    if (r.type == VAR || r.type == NUM) {
+        sum += r.getval();
+    }
+    for (int k = 0; k < T.size(t); k++) {
+        auto l = T.leaf(t, k);
+        same += T.root[l] == r;
+        if (T.root[l].type == VAR) {
+            sum += T.root[l].getval();
+        }
+        Walk(T, l);
+    }
+}
+
+int main(int argc, char** argv) {
+    auto p = ParseFile(argv[1]);
+    int runs = argc > 2 ? atoi(argv[2]) : 10;
+    std::vector<double> ms;
+    for (int run = 0; run < runs; run++) {
+        auto start = std::chrono::steady_clock::now();
+        for (int k = 0; k < 50; k++) {
+            for (auto f : p.functions) {
+                for (auto c : f->contexts) {
+                    for (auto t : c->trees) {
+                        Walk(f->trees, t);
+                    }
+                }
+            }
+        }
+        ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::sort(ms.begin(), ms.end());
+    std::printf("median %.1f ms, best %.1f ms over %d runs (%lld %lld)\n", ms[ms.size() / 2], ms[0], runs, (long long)sum, (long long)same);
+}
@@ -0,0 +1,25 @@
+#!/bin/bash
+# fuzz.sh COMPILER N [SIZE] [FLAGS...] : compiles the programs of seeds 1 to N, checking the output of each
+# against the reference interpreter
+comp=$(realpath "$1"); n=$2; size=${3:-1}; shift 3; flags="$@"
+here=$(cd "$(dirname "$0")" && pwd)
+work=$(mktemp -d)
+trap 'rm -rf $work' EXIT
+one() {
+  s=$1; d=$work/$s; mkdir -p $d; cd $d
+  python3 $here/gen.py $s $size > prog.L3
+  timeout 120 python3 $here/l3.py prog.L3 > ref.txt 2>&1
+  if ! timeout 20 $comp $flags prog.L3 > cc.log 2>&1; then echo "seed $s: compiler failed"; return; fi
+  timeout 120 python3 $here/l2.py prog.L2 > out.txt 2>&1
+  cmp -s out.txt ref.txt && return
+  # a reference run ending on a fault is undefined, the compiled program only has to agree up to the fault
+  if tail -1 ref.txt | grep -q ERROR && python3 -c "import sys; r = open(sys.argv[1]).read().splitlines()[:-1]; o = open(sys.argv[2]).read().splitlines(); sys.exit(o[:len(r)] != r)" ref.txt out.txt; then
+    return
+  fi
+  echo "seed $s: wrong output"
+}
+export -f one; export comp size flags here work
+seq 1 $n | xargs -P "$(nproc)" -I{} bash -c 'one {}' | sort -V > $work/failures.txt
+cat $work/failures.txt
+echo "failures: $(wc -l < $work/failures.txt) / $n"
+[ ! -s $work/failures.txt ]
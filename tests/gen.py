@@ -0,0 +1,163 @@
+# random L3 programs for differential testing: python3 gen.py SEED [SIZE]
+import random, sys
+
+class G:
+    def __init__(self, seed, size=1):
+        self.r = random.Random(seed)
+        self.size = size
+        self.lab = 0
+    def L(self, p='L'):
+        self.lab += 1
+        return ':%s%d' % (p, self.lab)
+    def func(self, name, nparams, callees, is_main=False):
+        r = self.r
+        params = ['%%p%d' % i for i in range(nparams)]
+        vars_ = params + ['%%x%d' % i for i in range(r.randint(3, 7))]
+        out = []
+        for v in vars_[nparams:]:
+            out.append('%s <- %d' % (v, r.randint(-5, 40)))
+        for v in ['%pp', '%e1', '%e2', '%e3', '%c', '%w']:
+            out.append('%s <- 0' % v)
+        self.K = r.randint(3, 9)
+        out.append('%%arr <- call allocate(%d, 1)' % (2 * self.K + 1))
+        self.vars = vars_
+        self.callees = callees
+        self.depth = 0
+        self.body(out, r.randint(4, 10) * self.size)
+        out += self.printv(r.choice(vars_))
+        if is_main:
+            out.append('call print(%arr)')
+            out.append('return')
+        else:
+            out.append('return %s' % r.choice(vars_))
+        return 'define %s (%s) {\n%s\n}\n' % (name, ', '.join(params), '\n'.join('  ' + s for s in out))
+    def t(self):
+        r = self.r
+        return r.choice(self.vars) if r.random() < 0.7 else str(r.randint(-3, 20))
+    def printv(self, v):
+        return ['%%pp <- %s << 1' % v, '%pp <- %pp + 1', 'call print(%pp)']
+    def body(self, out, n, idx=None):
+        r = self.r
+        for _ in range(n):
+            k = r.random()
+            V = self.vars
+            if k < 0.30:
+                op = r.choice(['+', '-', '*', '&', '+', '-', '<', '<=', '=', '>', '>='])
+                out.append('%s <- %s %s %s' % (r.choice(V), self.t(), op, self.t()))
+            elif k < 0.36:
+                op = r.choice(['<<', '>>'])
+                out.append('%s <- %s %s %d' % (r.choice(V), r.choice(V), op, r.randint(0, 4)))
+            elif k < 0.42:
+                c = r.choice([0, 1, 2, 3, 4, 5, 8, 9, 10, 16, 24, 7, -1])
+                a = r.choice(V)
+                out.append('%s <- %s * %d' % (r.choice(V), a, c) if r.random() < 0.7 else '%s <- %d * %s' % (r.choice(V), c, a))
+            elif k < 0.46:
+                a = r.choice(V); b = r.choice(V); d = r.choice(V)
+                # LA-style encoded add: decode, add, encode
+                out += ['%%e1 <- %s << 1' % a, '%e1 <- %e1 + 1', '%%e2 <- %s << 1' % b, '%e2 <- %e2 + 1',
+                        '%e1 <- %e1 >> 1', '%e2 <- %e2 >> 1', '%e3 <- %e1 + %e2', '%e3 <- %e3 << 1', '%e3 <- %e3 + 1',
+                        '%%s <- %%e3 >> 1' % () if False else '%s <- %%e3 >> 1' % d]
+            elif k < 0.49:
+                a = r.choice(V); d = r.choice(V)
+                out += ['%%e1 <- %s << 1' % a, '%e1 <- %e1 + 1', '%e1 <- %e1 >> 1', '%%e1 <- %%e1 + %d' % r.randint(0, 5),
+                        '%e1 <- %e1 << 1', '%e1 <- %e1 + 1', '%s <- %%e1 >> 1' % d]
+            elif k < 0.52:
+                out.append('%s <- %s' % (r.choice(V), self.t()))
+            elif k < 0.58 and idx is not None:
+                # array access at idx
+                a = r.choice(V)
+                out += ['%%o <- %s * 8' % idx, '%o <- %o + 8', '%ad <- %arr + %o']
+                if r.random() < 0.5:
+                    out += ['%%w <- %s << 1' % a, '%w <- %w + 1', 'store %ad <- %w']
+                else:
+                    out += ['%w <- load %ad', '%s <- %%w >> 1' % a]
+            elif k < 0.58:
+                pass
+            elif k < 0.66 and self.depth < 2:
+                self.depth += 1
+                i = '%%i%d' % self.lab
+                lh, lb, le = self.L('h'), self.L('b'), self.L('e')
+                bound = r.randint(0, self.K)
+                out += ['%s <- 0' % i, lh]
+                if r.random() < 0.5:
+                    out += ['%%c <- %s < %d' % (i, bound), 'br %%c %s' % lb, 'br %s' % le, lb]
+                else:
+                    out += ['%%c <- %s >= %d' % (i, bound), 'br %%c %s' % le, lb]
+                save = self.vars
+                self.body(out, r.randint(1, 6), i)
+                self.vars = save
+                out += ['%s <- %s + 1' % (i, i), 'br %s' % lh, le]
+                self.depth -= 1
+            elif k < 0.72 and self.depth < 3:
+                self.depth += 1
+                lt, lj = self.L('t'), self.L('j')
+                out += ['%%c <- %s %s %s' % (self.t(), r.choice(['<', '<=', '=', '>', '>=']), self.t()), 'br %%c %s' % lt]
+                self.body(out, r.randint(0, 3), idx)
+                out += ['br %s' % lj, lt]
+                self.body(out, r.randint(0, 3), idx)
+                out += [lj]
+                self.depth -= 1
+            elif k < 0.80 and self.callees:
+                f, np = r.choice(self.callees)
+                args = ', '.join(self.t() for _ in range(np))
+                if r.random() < 0.25:
+                    out += ['%%fp <- %s' % f, '%s <- call %%fp(%s)' % (r.choice(V), args)]
+                else:
+                    out.append('%s <- call %s(%s)' % (r.choice(V), f, args))
+            elif k < 0.86:
+                out += self.printv(r.choice(V))
+            elif k < 0.90:
+                # redundant recomputation
+                a, b = r.choice(V), r.choice(V)
+                op = r.choice(['+', '*', '&', '<<'])
+                bb = b if op != '<<' else '2'
+                out += ['%s <- %s %s %s' % (r.choice(V), a, op, bb), '%s <- %s %s %s' % (r.choice(V), a, op, bb)]
+            elif k < 0.93:
+                out.append('br %d %s' % (r.randint(0, 1), self.skip(out)))
+            elif k < 0.96:
+                c = r.randint(-10, 10); d = r.randint(0, 10)
+                out.append('%s <- %d %s %d' % (r.choice(V), c, r.choice(['+', '-', '*', '&', '<', '<=', '=']), d))
+            else:
+                out.append('%s <- %s %s' % (r.choice(V), r.choice(V), r.choice(['+ 0', '* 1', '* 0', '& -1', '<< 0', '- 0'])))
+    def skip(self, out):
+        l = self.L('s')
+        self.pending = l
+        out.append('__PLACEHOLDER__')
+        return l
+
+def program(seed, size=1):
+    g = G(seed, size)
+    r = g.r
+    nf = r.randint(1, 4)
+    sigs = [('@f%d' % i, r.randint(0, 8)) for i in range(nf)]
+    text = ''
+    for i in reversed(range(nf)):
+        text += g.func(sigs[i][0], sigs[i][1], sigs[i + 1:])
+    text = g.func('@main', 0, sigs, True) + text
+    # resolve br const placeholders: label placed right after the next instruction
+    lines = text.split('\n')
+    res = []
+    pend = []
+    for ln in lines:
+        if ln.strip() == '__PLACEHOLDER__':
+            continue
+        res.append(ln)
+    out = []
+    i = 0
+    while i < len(res):
+        ln = res[i]
+        out.append(ln)
+        s = ln.strip()
+        if s.startswith('br ') and len(s.split()) == 3 and s.split()[1].lstrip('-').isdigit():
+            lab = s.split()[2]
+            # place label after one following plain instruction (not label/br/return/})
+            j = i + 1
+            if j < len(res) and res[j].strip().startswith(('%x', '%p')):
+                out.append(res[j]); i = j
+            out.append('  ' + lab)
+        i += 1
+    return '\n'.join(out)
+
+if __name__ == '__main__':
+    seed = int(sys.argv[1]); size = int(sys.argv[2]) if len(sys.argv) > 2 else 1
+    print(program(seed, size))
@@ -0,0 +1,155 @@
+# L2 interpreter: python3 l2.py prog.L2 [steps] prints the output of the program, and the instructions run on stderr
+import sys, re
+sys.setrecursionlimit(100000)
+from runtime import Runtime, wrap
+
+def tokenize_program(text):
+    funcs = {}
+    lines = text.split('\n')
+    cur = None
+    entry = None
+    for ln in lines:
+        s = ln.strip()
+        if not s:
+            continue
+        if s.startswith('('):
+            name = s[1:].strip()
+            if entry is None:
+                entry = name
+                continue
+            cur = {'name': name, 'n': None, 'ins': []}
+            funcs[name] = cur
+            continue
+        if s == ')':
+            cur = None
+            continue
+        if cur['n'] is None:
+            cur['n'] = int(s)
+            continue
+        cur['ins'].append(s.split())
+    for f in funcs.values():
+        f['labels'] = {ins[0]: k for k, ins in enumerate(f['ins']) if len(ins) == 1 and ins[0].startswith(':')}
+    return entry, funcs
+
+REGS = {'rdi', 'rsi', 'rdx', 'rcx', 'r8', 'r9', 'rax', 'rbx', 'rbp', 'r10', 'r11', 'r12', 'r13', 'r14', 'r15', 'rsp'}
+ARGREGS = ['rdi', 'rsi', 'rdx', 'rcx', 'r8', 'r9']
+
+class L2:
+    def __init__(self, funcs):
+        self.funcs = funcs
+        self.rt = Runtime()
+        self.regs = {r: 0 for r in REGS}
+        self.regs['rsp'] = 1 << 40
+    def val(self, fr, t):
+        if t.startswith('%'):
+            if t not in fr:
+                raise RuntimeError("read of undefined var " + t)
+            return fr[t]
+        if t in REGS:
+            return self.regs[t]
+        if t.startswith(':') or t.startswith('@'):
+            return t
+        return int(t)
+    def setv(self, fr, w, v):
+        if w in REGS:
+            self.regs[w] = v
+        else:
+            fr[w] = v
+    def call(self, name):
+        f = self.funcs[name]
+        fr = {}
+        ins = f['ins']
+        pc = 0
+        rt = self.rt
+        while True:
+            rt.tick()
+            x = ins[pc]
+            pc += 1
+            n = len(x)
+            if n == 1:
+                if x[0] == 'return':
+                    return
+                continue  # label
+            if x[0] == 'goto':
+                pc = f['labels'][x[1]]
+                continue
+            if x[0] == 'cjump':
+                if self.cmp(fr, x[1], x[2], x[3]):
+                    pc = f['labels'][x[4]]
+                continue
+            if x[0] == 'call':
+                self.do_call(fr, x[1], int(x[2]))
+                continue
+            if x[0] == 'mem':
+                addr = wrap(self.val(fr, x[1]) + int(x[2]))
+                if x[3] == '<-':
+                    rt.store(addr, self.val(fr, x[4]))
+                else:
+                    rt.store(addr, self.aop(x[3], rt.load(addr), self.val(fr, x[4])))
+                continue
+            w = x[0]
+            op = x[1]
+            if op == '<-':
+                if n == 3:
+                    self.setv(fr, w, self.val(fr, x[2]))
+                elif x[2] == 'mem':
+                    self.setv(fr, w, rt.load(wrap(self.val(fr, x[3]) + int(x[4]))))
+                elif x[2] == 'stack-arg':
+                    self.setv(fr, w, rt.load(self.regs['rsp'] + int(x[3])))
+                else:
+                    self.setv(fr, w, 1 if self.cmp(fr, x[2], x[3], x[4]) else 0)
+            elif op == '@':
+                self.setv(fr, w, wrap(self.val(fr, x[2]) + self.val(fr, x[3]) * int(x[4])))
+            else:
+                self.setv(fr, w, self.aop(op, self.val(fr, w), self.val(fr, x[2])))
+    def cmp(self, fr, a, c, b):
+        a = self.val(fr, a); b = self.val(fr, b)
+        return {'<': a < b, '<=': a <= b, '=': a == b}[c]
+    def aop(self, op, a, b):
+        if op == '+=': return wrap(a + b)
+        if op == '-=': return wrap(a - b)
+        if op == '*=': return wrap(a * b)
+        if op == '&=': return wrap(a & b)
+        if op == '<<=': return wrap(a << (b & 63))
+        if op == '>>=': return wrap(a >> (b & 63))
+        raise RuntimeError(op)
+    def do_call(self, fr, u, n):
+        rt = self.rt
+        if u == 'print':
+            rt.print_(self.regs['rdi']); return
+        if u == 'allocate':
+            self.regs['rax'] = rt.allocate(self.regs['rdi'], self.regs['rsi']); return
+        if u == 'input':
+            self.regs['rax'] = 1; return
+        if u == 'tensor-error':
+            raise RuntimeError("tensor-error")
+        callee = self.val(fr, u)
+        saved = self.regs['rsp']
+        self.regs['rsp'] = saved - 8 - 8 * max(0, n - 6)
+        self.call(callee)
+        self.regs['rsp'] = saved
+        for r in ARGREGS + ['r10', 'r11']:
+            self.regs[r] = 0xdead
+
+# "%v5++" comes as a single token
+def norm(funcs):
+    for f in funcs.values():
+        new = []
+        for x in f['ins']:
+            if len(x) == 1 and (x[0].endswith('++') or x[0].endswith('--')):
+                x = [x[0][:-2], '+=' if x[0].endswith('++') else '-=', '1']
+            new.append(x)
+        f['ins'] = new
+        f['labels'] = {ins[0]: k for k, ins in enumerate(f['ins']) if len(ins) == 1 and ins[0].startswith(':')}
+
+if __name__ == '__main__':
+    entry, funcs = tokenize_program(open(sys.argv[1]).read())
+    norm(funcs)
+    m = L2(funcs)
+    try:
+        m.call(entry)
+    except RuntimeError as e:
+        print('\n'.join(m.rt.out)); print("ERROR:", e); sys.exit(1)
+    print('\n'.join(m.rt.out))
+    if len(sys.argv) > 2:
+        print("steps", m.rt.steps, file=sys.stderr)
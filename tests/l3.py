@@ -0,0 +1,87 @@
+# L3 reference interpreter: python3 l3.py prog.L3 prints the output the compiled program has to match
+import sys, re
+sys.setrecursionlimit(100000)
+from runtime import Runtime, wrap
+
+def parse(text):
+    text = re.sub(r'//[^\n]*', '', text)
+    funcs = {}
+    for m in re.finditer(r'define\s+(@\w+)\s*\(([^)]*)\)\s*\{(.*?)\}', text, re.S):
+        name, params, body = m.group(1), m.group(2), m.group(3)
+        params = [p.strip() for p in params.split(',') if p.strip()]
+        ins = []
+        for ln in body.split('\n'):
+            s = ln.strip()
+            if s:
+                ins.append(s)
+        labels = {s: k for k, s in enumerate(ins) if re.fullmatch(r':\w+', s)}
+        funcs[name] = (params, ins, labels)
+    return funcs
+
+class L3:
+    def __init__(self, funcs):
+        self.funcs = funcs
+        self.rt = Runtime()
+    def val(self, fr, t):
+        t = t.strip()
+        if t.startswith('%'):
+            if t not in fr: raise RuntimeError("undef " + t)
+            return fr[t]
+        if t.startswith('@') or t.startswith(':'):
+            return t
+        return int(t)
+    def call(self, name, args):
+        params, ins, labels = self.funcs[name]
+        fr = dict(zip(params, args))
+        pc = 0
+        rt = self.rt
+        while True:
+            rt.tick()
+            if pc >= len(ins):
+                return 0
+            s = ins[pc]; pc += 1
+            m = re.fullmatch(r':\w+', s)
+            if m: continue
+            if s == 'return': return 0
+            m = re.fullmatch(r'return\s+(\S+)', s)
+            if m: return self.val(fr, m.group(1))
+            m = re.fullmatch(r'br\s+(:\w+)', s)
+            if m: pc = labels[m.group(1)]; continue
+            m = re.fullmatch(r'br\s+(\S+)\s+(:\w+)', s)
+            if m:
+                if self.val(fr, m.group(1)) == 1: pc = labels[m.group(2)]
+                continue
+            m = re.fullmatch(r'store\s+(%\w+)\s*<-\s*(\S+)', s)
+            if m: rt.store(self.val(fr, m.group(1)), self.val(fr, m.group(2))); continue
+            m = re.fullmatch(r'(?:(%\w+)\s*<-\s*)?call\s+(\S+?)\s*\((.*)\)', s)
+            if m:
+                args = [self.val(fr, a) for a in m.group(3).split(',') if a.strip()]
+                u = m.group(2)
+                if u == 'print': rt.print_(args[0]); r = 0
+                elif u == 'allocate': r = rt.allocate(args[0], args[1])
+                elif u == 'input': r = 1
+                elif u == 'tensor-error': raise RuntimeError("tensor-error")
+                else: r = self.call(self.val(fr, u), args)
+                if m.group(1): fr[m.group(1)] = r
+                continue
+            m = re.fullmatch(r'(%\w+)\s*<-\s*load\s+(%\w+)', s)
+            if m: fr[m.group(1)] = rt.load(self.val(fr, m.group(2))); continue
+            m = re.fullmatch(r'(%\w+)\s*<-\s*(\S+)\s*(<<|>>|<=|>=|<|>|=|\+|-|\*|&)\s*(\S+)', s)
+            if m:
+                a = self.val(fr, m.group(2)); b = self.val(fr, m.group(4)); op = m.group(3)
+                r = {'+': lambda: wrap(a + b), '-': lambda: wrap(a - b), '*': lambda: wrap(a * b), '&': lambda: wrap(a & b),
+                     '<<': lambda: wrap(a << (b & 63)), '>>': lambda: a >> (b & 63),
+                     '<': lambda: int(a < b), '<=': lambda: int(a <= b), '=': lambda: int(a == b), '>': lambda: int(a > b), '>=': lambda: int(a >= b)}[op]()
+                fr[m.group(1)] = r; continue
+            m = re.fullmatch(r'(%\w+)\s*<-\s*(\S+)', s)
+            if m: fr[m.group(1)] = self.val(fr, m.group(2)); continue
+            raise RuntimeError("bad instr " + s)
+
+if __name__ == '__main__':
+    f = parse(open(sys.argv[1]).read())
+    m = L3(f)
+    try:
+        m.call('@main', [])
+    except RuntimeError as e:
+        print('\n'.join(m.rt.out)); print("ERROR:", e); sys.exit(1)
+    print('\n'.join(m.rt.out))
@@ -0,0 +1,113 @@
+/*
+ * the liveness of every function solved again the way MergeTree did before the bit vectors, a std::set of vars
+ * per instruction swept backward to a fixpoint, and checked against Liveness: the IN and OUT of every block
+ * and the live_out answer for every var each instruction reads or writes
+ *   g++ -std=c++20 -O2 -I<PEGTL>/include -I. $(ls *.cpp | grep -v compiler.cpp) tests/liveness_check.cpp -o liveness_check
+ *   liveness_check FILE...    exits with 1 on any difference
+ *   the sets take as much memory as they did, thousands of vars live across a loop of thousands of instructions take gigabytes
+ */
+#include <iostream>
+#include <set>
+#include <vector>
+
+#include <L3parser.h>
+#include <passes.h>
+
+using namespace L3;
+
+/* vars read by tree t into gen, the var it writes into kill, as MergeTree generated its sets */
+static void Sets(TreePool& T, Node t, std::set<int>& gen, int& kill) {
+    auto read = [&](Node l) {
+        if (T.root[l].type == VAR) {
+            gen.insert(T.root[l].getval());
+        }
+    };
+    kill = -1;
+    if (T.op[t] < Op::cjmp || T.op[t] == Op::call) {
+        if (T.root[t].type == VAR) {
+            kill = T.root[t].getval();
+        }
+        int n = T.op[t] == Op::call ? T.size(t) - 2 : T.size(t);   // a call skips its return label
+        for (int k = 0; k < n; k++) {
+            read(T.leaf(t, k));
+        }
+        if (T.op[t] == Op::call) {
+            read(T.back(t));
+        }
+    } else if (T.op[t] == Op::cjmp) {
+        read(T.left[t]);
+    }
+}
+
+static int64_t Check(Function* f, Analyses& a, int64_t& answers) {
+    auto& g = a.cfg(f);
+    auto& L = a.liveness(f);
+    auto& T = f->trees;
+    std::vector<std::set<int>> gen (g.size);
+    std::vector<int> kill (g.size, -1);
+    for (int i = 0; i < g.size; i++) {
+        if (g.inst[i] != NIL) {
+            Sets(T, g.inst[i], gen[i], kill[i]);
+        }
+    }
+
+    std::vector<std::set<int>> in (g.size);
+    std::vector<std::set<int>> out (g.size);
+    for (bool changed = true; changed; ) {
+        changed = false;
+        for (int i = g.size - 1; i >= 0; i--) {
+            int b = g.block_of[i];
+            std::set<int> o;
+            if (i < g.last[b]) {
+                o = in[i + 1];
+            } else {
+                for (auto s : g.succ[b]) {
+                    o.insert(in[g.first[s]].begin(), in[g.first[s]].end());
+                }
+            }
+            std::set<int> n = o;
+            n.erase(kill[i]);
+            n.insert(gen[i].begin(), gen[i].end());
+            if (o != out[i] || n != in[i]) {
+                out[i] = o;
+                in[i] = n;
+                changed = true;
+            }
+        }
+    }
+
+    int64_t wrong = 0;
+    for (int b = 0; b < g.blocks(); b++) {
+        for (int v = 1; v < L.bits; v++) {
+            wrong += L.flow.IN.test(b, v) != (in[g.first[b]].count(v) > 0);
+            wrong += L.flow.OUT.test(b, v) != (out[g.last[b]].count(v) > 0);
+        }
+    }
+    for (int i = 0; i < g.size; i++) {
+        std::set<int> vars = gen[i];
+        if (kill[i] >= 0) {
+            vars.insert(kill[i]);
+        }
+        for (auto v : vars) {
+            wrong += L.live_out(i, v) != (out[i].count(v) > 0);
+            answers++;
+        }
+    }
+    return wrong;
+}
+
+int main(int argc, char** argv) {
+    int64_t wrong = 0;
+    for (int k = 1; k < argc; k++) {
+        auto p = ParseFile(argv[k]);
+        Analyses a (p);
+        int64_t answers = 0;
+        int64_t differ = 0;
+        for (auto f : p.functions) {
+            differ += Check(f, a, answers);
+        }
+        std::cout << argv[k] << ": " << p.functions.size() << " functions, " << answers << " live_out answers, " << differ << " differences" << std::endl;
+        wrong += differ;
+    }
+    return wrong != 0;
+}
@@ -0,0 +1,26 @@
+#!/bin/bash
+# run.sh COMPILER : compiles the programs and kernels at each -O level, runs the L2 on the interpreter
+# and checks its output, printing the instructions each kernel ran
+comp=$(realpath "$1")
+here=$(cd "$(dirname "$0")" && pwd)
+work=$(mktemp -d)
+trap 'rm -rf $work' EXIT
+fail=0
+for f in $here/programs/*.L3 $here/kernels/*.L3; do
+  name=$(basename $(dirname $f))/$(basename $f .L3)
+  for o in 0 1 2 3; do
+    rm -f $work/prog.L2
+    if ! (cd $work && timeout 20 $comp -O $o $f > cc.log 2>&1); then
+      echo "$name -O$o: compiler failed"; fail=$((fail + 1)); continue
+    fi
+    timeout 300 python3 $here/l2.py $work/prog.L2 steps > $work/out.txt 2> $work/steps.txt
+    if ! cmp -s $work/out.txt ${f%.L3}.out; then
+      echo "$name -O$o: wrong output"; fail=$((fail + 1)); continue
+    fi
+    case $name in
+      kernels/*) echo "$name -O$o: $(awk '{print $2}' $work/steps.txt) steps";;
+    esac
+  done
+done
+echo "failures: $fail"
+[ $fail -eq 0 ]
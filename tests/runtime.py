@@ -0,0 +1,50 @@
+# the L3 runtime both interpreters share: 64-bit wrap around, allocate, print, and a step count
+M64 = (1 << 64) - 1
+STEPS = 20000000
+
+def wrap(x):
+    x &= M64
+    return x - (1 << 64) if x >> 63 else x
+
+class Runtime:
+    def __init__(self):
+        self.mem = {}
+        self.heap = 1 << 32
+        self.out = []
+        self.steps = 0
+
+    # an array of n >> 1 words set to v, its size in the word ahead of them
+    def allocate(self, n, v):
+        size = n >> 1
+        base = self.heap
+        self.heap += 8 * (size + 1) + 64
+        self.mem[base] = size
+        for i in range(size):
+            self.mem[base + 8 * (i + 1)] = v
+        return base
+
+    def fmt(self, v, depth=0):
+        if isinstance(v, str):
+            return v
+        if v & 1:
+            return str(v >> 1)
+        if v in self.mem and depth < 4 and v >= (1 << 32):
+            size = self.mem[v]
+            return "{s:%d, %s}" % (size, ", ".join(self.fmt(self.mem.get(v + 8 * (i + 1), 0), depth + 1) for i in range(size)))
+        return str(v >> 1)
+
+    def print_(self, v):
+        self.out.append(self.fmt(v))
+
+    def load(self, a):
+        if a not in self.mem:
+            raise RuntimeError("load from unmapped %r" % (a,))
+        return self.mem[a]
+
+    def store(self, a, v):
+        self.mem[a] = v
+
+    def tick(self):
+        self.steps += 1
+        if self.steps > STEPS:
+            raise RuntimeError("step limit")
@@ -3,96 +3,408 @@
 #include <fstream>
 #include <cassert>
 #include <vector>
+#include <chrono>
+#include <algorithm>
+#include <map>
 
 
 
 #include <tile.h>
+#include <lvn.h>
+#include <report.h>
 
 namespace L3 {
-    void TreeSimplifier(std::vector<Tile*>& all);
-	void PatternGenerator(std::vector<Tile*>& all);
-	Pattern* Cover(Tree* i, std::vector<Tile*>& all);
-
-	void MaximalMunch(Program &p) {
-		std::vector<Tile*> pre;
-	    std::vector<Tile*> all;
-		TreeSimplifier(pre);
-		PatternGenerator(all);                  // hard encoded maximum rule guarantee
-		
+
+	/* one run of the tiles over a program, which owns the tiles it makes */
+	class Tiler {
+	  public:
+		Tiler (Program& p, bool plain, TileProfile* profile);
+
+		void run(LvnStats& values, Analyses* a);
+
+	  private:
+		template <typename T>
+		T* Make(const char* name, bool basic = false);
+		void TreeSimplifier();
+		void PatternGenerator();
+		int Cost(Function* f, Node i);
+		void Label(Function* f, Node i);
+		void Cover(Function* f, Node i, std::vector<Match>& out);
+		void Rewrite(Function* f, Node i);
+		bool Settle(Function* f, Node i, TileSet& pre);
+		void Resettle(Function* f, Node i, TileSet& pre);
+		int TryCover(Tile* t, Function* f, Node i, Match& m);
+		bool TryRewrite(Tile* t, Function* f, Node i);
+		void Chosen(Function* f, const Match& m);
+
+		Program& p;
+		bool plain;
+		TileProfile* profile;
+		TileSet down;
+		TileSet up;
+		TileSet all;
+
+		/* minimum cost cover of the nodes of the tree being tiled, Cover follows it while labeled */
+		std::vector<int> best_cost;
+		std::vector<Tile*> best_tile;
+		bool labeled = false;
+
+		std::vector<Node> kids;  // subtrees left by the tiles, each level of Cover works above the levels calling it
+	};
+
+	Tiler::Tiler (Program& p, bool plain, TileProfile* profile)
+	  : p {p},
+	    plain {plain},
+	    profile {profile && profile->enabled ? profile : NULL} {
+		if(!plain) {
+			TreeSimplifier();
+		}
+		PatternGenerator();                     // hard encoded maximum rule guarantee
+	}
+
+	void MaximalMunch(Program &p, bool plain, LvnStats& values, TileProfile* profile, Analyses* a) {
+		Tiler(p, plain, profile).run(values, a);
+	}
+
+	/* the cheapest tile of every node of tree i, bottom-up */
+	int Tiler::Cost(Function* f, Node i) {
+		best_cost.resize(f->trees.op.size());
+		best_tile.resize(f->trees.op.size());
+		Label(f, i);
+		return best_cost[i];
+	}
+
+	void Tiler::run(LvnStats& values, Analyses* a) {
 		for(auto f : p.functions) {
+			report.begin_function(f->name);
+			int hoisted = values.hoisted;
+			if(!plain) {
+				for(auto c : f->contexts) {
+					for(auto i : c->trees) {
+						Rewrite(f, i);             // simplify the original trees
+					}
+				}
+				NumberValues(f, a ? &a->dominators(f) : NULL, [&](Node i) { return Cost(f, i); }, values);   // then compute each expression once
+			}
 			for(auto c : f->contexts) {
+				c->matches.reserve(c->trees.size());  // a match per tree at least
 				for(auto i : c->trees) {
-					Cover(i, pre);              // run all of the methods to simplify the original tree
-					auto p = Cover(i, all);     // cover the tree with the optimal method to achieve maximal munch
-					c->patterns.push_back(p);
+					if(!plain) {
+						Cost(f, i);
+						labeled = true;
+					}
+					Cover(f, i, c->matches);  // cover the tree with the labeled tiles, or the first matching ones
+					labeled = false;
+				}
+			}
+			if(values.hoisted != hoisted) {
+				Renumber(f);
+			}
+			report.end_function();
+		}
+	}
+
+	void TilePass::run(Program& p, Analyses& a, int optLevel) {
+		MaximalMunch(p, optLevel == 0, values, &profile, optLevel >= 2 ? &a : NULL);
+	}
+
+	/* cover and rewrite of a tile, counted and timed when profiling */
+	int Tiler::TryCover(Tile* t, Function* f, Node i, Match& m) {
+		if(!profile) {
+			return t->cover(f, i, m, kids);
+		}
+		auto start = std::chrono::steady_clock::now();
+		int cost = t->cover(f, i, m, kids);
+		int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		auto& stats = profile->tiles[t->id];
+		stats.attempts++;
+		if(cost >= 0) {
+			stats.matches++;
+			stats.matched_ns += ns;
+		} else {
+			stats.failed_ns += ns;
+		}
+		return cost;
+	}
+
+	bool Tiler::TryRewrite(Tile* t, Function* f, Node i) {
+		if(!profile) {
+			return t->rewrite(f, i);
+		}
+		auto start = std::chrono::steady_clock::now();
+		bool changed = t->rewrite(f, i);
+		int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		auto& stats = profile->tiles[t->id];
+		stats.attempts++;
+		if(changed) {
+			stats.matches++;
+			stats.matched_ns += ns;
+		} else {
+			stats.failed_ns += ns;
+		}
+		return changed;
+	}
+
+	static std::string OpName(Op op) {
+		static const char* names[] = {"add", "addn", "sub", "subn", "mult", "multn", "band", "bandn", "s_l", "s_ln", "s_r", "s_rn",
+		        "c_l", "c_le", "c_e", "c_g", "c_ge", "asmt", "load", "store", "ret", "cjmp", "br", "label", "call", "leaf"};
+		return names[op];
+	}
+
+	/* the tree at i down to depth levels, constants by value, other leaves by kind */
+	static std::string Shape(Function* f, Node i, int depth) {
+		auto& T = f->trees;
+		if(T.op[i] == Op::leaf) {
+			auto r = T.root[i];
+			return r.type == NUM ? std::to_string(r.getval()) : r.type == VAR ? "v" : r.type == LABEL ? "l" : "f";
+		}
+		if(depth == 0 || T.op[i] == Op::call) {
+			return "(" + OpName(T.op[i]) + ")";
+		}
+		std::string s = "(" + OpName(T.op[i]);
+		for(int k = 0; k < T.size(i); k++) {
+			s += " " + Shape(f, T.leaf(i, k), depth - 1);
+		}
+		return s + ")";
+	}
+
+	void Tiler::Chosen(Function* f, const Match& m) {
+		auto& stats = profile->tiles[m.tile->id];
+		stats.chosen++;
+		auto v = m.tile->variant(m);
+		if(!v.empty()) {
+			stats.variants[v]++;
+		}
+		if(stats.basic) {
+			profile->shapes[Shape(f, m.node, 2)]++;
+		}
+	}
+
+	void TileProfile::print(std::ostream& out) {
+		char line[160];
+		out << "tile                       attempts      matches       chosen   matched ms    failed ms\n";
+		for(auto& t : tiles) {
+			std::snprintf(line, sizeof(line), "%-24s %12lld %12lld %12lld %12.3f %12.3f\n", t.name.c_str(), (long long)t.attempts,
+			              (long long)t.matches, (long long)t.chosen, t.matched_ns / 1e6, t.failed_ns / 1e6);
+			out << line;
+			for(auto& v : t.variants) {
+				std::snprintf(line, sizeof(line), "  %-22s %38lld\n", v.first.c_str(), (long long)v.second);
+				out << line;
+			}
+		}
+
+		std::vector<std::pair<int64_t, std::string>> sorted;
+		for(auto& s : shapes) {
+			sorted.push_back({s.second, s.first});
+		}
+		std::sort(sorted.begin(), sorted.end(), [](const std::pair<int64_t, std::string>& a, const std::pair<int64_t, std::string>& b) {
+			return a.first != b.first ? a.first > b.first : a.second < b.second;
+		});
+		out << "trees left to the basic tiles, " << sorted.size() << " shapes\n";
+		for(int k = 0; k < (int)sorted.size() && k < 30; k++) {
+			std::snprintf(line, sizeof(line), "%12lld  ", (long long)sorted[k].first);
+			out << line << sorted[k].second << "\n";
+		}
+	}
+
+	/*
+	 * dynamic programming over the tree, each node is labeled once with the tile minimizing
+	 * its own L2 instructions plus the best cost of the subtrees that tile leaves
+	 */
+	void Tiler::Label(Function* f, Node i) {
+		auto& T = f->trees;
+		for(int k = 0; k < T.size(i); k++) {
+			auto l = T.leaf(i, k);
+			if(T.op[l] != Op::leaf) {
+				Label(f, l);
+			}
+		}
+
+		Match m;
+		best_cost[i] = INT32_MAX;
+		best_tile[i] = NULL;
+		for(auto t : all.candidates[T.op[i]]) {   // ties go to the earlier tile
+			kids.clear();
+			int cost = TryCover(t, f, i, m);
+			if(cost < 0) {
+				continue;
+			}
+			for(auto k : kids) {
+				if(T.op[k] != Op::leaf) {
+					cost += best_cost[k];
 				}
 			}
+			if(cost < best_cost[i]) {
+				best_cost[i] = cost;
+				best_tile[i] = t;
+			}
+		}
+		kids.clear();
+	}
+
+	/* the matches of the subtrees left by the tile of node i, the later subtree first, then its own */
+	void Tiler::Cover(Function* f, Node i, std::vector<Match>& out) {
+		auto& T = f->trees;
+		int base = kids.size();
+		Match m;
+		if(labeled) {
+			m.tile = best_tile[i];
+			int cost = TryCover(m.tile, f, i, m);
+			assert(cost >= 0);
+		} else {
+			for(auto t : all.candidates[T.op[i]]) {
+				if(TryCover(t, f, i, m) >= 0) {
+					m.tile = t;
+					break;
+				}
+				kids.resize(base);
+			}
+		}
+		assert(m.tile != NULL);
+		m.node = i;
+
+		for(int k = kids.size() - 1; k >= base; k--) {
+			if(T.op[kids[k]] != Op::leaf) {
+				Cover(f, kids[k], out);
+			}
+		}
+		kids.resize(base);
+		out.push_back(m);
+		if(profile) {
+			Chosen(f, m);
 		}
-		return;
 	}
 
-	Pattern* Cover(Tree* i, std::vector<Tile*>& all) {
-		for(auto t : all) {
-			auto p = t->try_to_cover(i, all);
-			if(p != NULL) {
-				return p;
+	/* the rewrites of node i until none applies, true when any did */
+	bool Tiler::Settle(Function* f, Node i, TileSet& pre) {
+		auto& T = f->trees;
+		bool changed = false;
+		for(int k = 0; k < (int)pre.candidates[T.op[i]].size(); k++) {
+			if(TryRewrite(pre.candidates[T.op[i]][k], f, i)) {
+				changed = true;
+				k = -1;                            // start over with the rules of what the node became
+			}
+		}
+		return changed;
+	}
+
+	/* after a rewrite of node i, its kids are new or renamed, settle them and go on down where they change */
+	void Tiler::Resettle(Function* f, Node i, TileSet& pre) {
+		auto& T = f->trees;
+		for(int k = 0; k < T.size(i); k++) {
+			auto l = T.leaf(i, k);
+			if(T.op[l] != Op::leaf && Settle(f, l, pre)) {
+				Resettle(f, l, pre);
 			}
 		}
 	}
 
+	/*
+	 * every simplification rule applied in a single walk of the tree
+	 *   on the way down the rules of down, undoing the LA encodings before the rules of the kids can break them,
+	 *   on the way up every rule, so a node is matched again once its subtrees are as simple as they get,
+	 *   the kids it rewrites or renames are settled again
+	 */
+	void Tiler::Rewrite(Function* f, Node i) {
+		auto& T = f->trees;
+		Settle(f, i, down);
+		for(int k = 0; k < T.size(i); k++) {
+			auto l = T.leaf(i, k);
+			if(T.op[l] != Op::leaf) {
+				Rewrite(f, l);
+			}
+		}
+		if(Settle(f, i, up)) {
+			Resettle(f, i, up);
+		}
+	}
+
+	void TileSet::add(Tile* t, std::initializer_list<Op> roots) {
+		tiles.push_back(t);
+		for(auto op : roots) {
+			candidates[op].push_back(t);
+		}
+	}
+
 	/*
 	 * Vector of tiles initialization, with hard encoded maximal munch guarantee
 	 */
-	void TreeSimplifier(std::vector<Tile*>& all) {  // traversal with each method to simplify the trees
-
-	    /* specials with knowledge of higher levels */	
-	    auto t11 = new Tile1_EncDec;
-		all.push_back(t11);
-		auto t12 = new Tile1_AsmtInTree;
-		all.push_back(t12);
-		auto t13 = new Tile1_SameLeftVarInTree;
-		all.push_back(t13);
-		auto t14 = new Tile1_IniMult;
-		all.push_back(t14);
-		auto t15 = new Tile1_ConsecMultn;
-		all.push_back(t15);
-		auto t16 = new Tile1_Addn;
-		all.push_back(t16);
-		auto t17 = new Tile1_Add;
-		all.push_back(t17);
+	template <typename T>
+	T* Tiler::Make(const char* name, bool basic) {  // a tile of the program, with its slot in the profile
+		auto t = p.arena.make<T>();
+		if(profile) {
+			t->id = profile->tiles.size();
+			profile->tiles.push_back(TileStats());
+			profile->tiles.back().name = name;
+			profile->tiles.back().basic = basic;
+		}
+		return t;
+	}
+
+	void Tiler::TreeSimplifier() {  // rules tried at each node in this order, see Rewrite
+		std::initializer_list<Op> aopSop = {Op::add, Op::addn, Op::sub, Op::subn, Op::mult, Op::multn,
+		        Op::band, Op::bandn, Op::s_l, Op::s_ln, Op::s_r, Op::s_rn};
+
+	    /* specials with knowledge of higher levels, the decodings also on the way down */
+	    auto t11 = Make<Tile1_EncDec>("Tile1_EncDec");
+		down.add(t11, {Op::s_rn});
+		up.add(t11, {Op::s_rn});
+		auto t12 = Make<Tile1_AsmtInTree>("Tile1_AsmtInTree");
+		down.add(t12, {Op::asmt});
+		up.add(t12, {Op::asmt});
+		auto t13 = Make<Tile1_SameLeftVarInTree>("Tile1_SameLeftVarInTree");
+		up.add(t13, aopSop);
+		auto t14 = Make<Tile1_IniMult>("Tile1_IniMult");
+		up.add(t14, {Op::mult});
+		auto t15 = Make<Tile1_ConsecMultn>("Tile1_ConsecMultn");
+		up.add(t15, {Op::multn, Op::s_ln});
+		auto t16 = Make<Tile1_Addn>("Tile1_Addn");
+		up.add(t16, {Op::addn});
+		auto t17 = Make<Tile1_Add>("Tile1_Add");
+		up.add(t17, {Op::addn});
 	}
 
-	void PatternGenerator(std::vector<Tile*>& all) {  // optimal method first to cover a tree and generate a pattern
-		
-	    /* tiles that cover multiiple levels of a tree */
-		auto t21 = new Tile2_Lea;
-		all.push_back(t21);
-		auto t22 = new Tile2_Cjump;
-		all.push_back(t22);
-		auto t23 = new Tile2_LoadM; 
-		all.push_back(t23);
-		auto t24 = new Tile2_SroreM;
-		all.push_back(t24); 
+	void Tiler::PatternGenerator() {  // optimal method first to cover a tree and generate a pattern
+
+	    /* tiles that cover multiiple levels of a tree, the only ones for cjump, load and store when plain */
+		if(!plain) {
+			auto t21 = Make<Tile2_Lea>("Tile2_Lea");
+			all.add(t21, {Op::add});
+		}
+		if(!plain) {
+			auto t25 = Make<Tile2_MulConst>("Tile2_MulConst");
+			all.add(t25, {Op::multn});
+		}
+		auto t22 = Make<Tile2_Cjump>("Tile2_Cjump");
+		all.add(t22, {Op::cjmp});
+		auto t23 = Make<Tile2_LoadM>("Tile2_LoadM");
+		all.add(t23, {Op::load});
+		auto t24 = Make<Tile2_SroreM>("Tile2_SroreM");
+		all.add(t24, {Op::store});
 
 		/* single level of a tree with better L2 code */
-	    auto t31 = new Tile3_PP;
-		all.push_back(t31);
-		auto t32 = new Tile3_SelfOp;
-		all.push_back(t32);
-
-		/* basics that do not overlap */
-		auto t41 = new Tile4_AopSop;
-		all.push_back(t41);
-		auto t42 = new Tile4_Asmt;
-		all.push_back(t42);
-		auto t43 = new Tile4_Cmp;
-		all.push_back(t43);
-		auto t44 = new Tile4_Ret;
-		all.push_back(t44);
-		auto t45 = new Tile4_Label;
-		all.push_back(t45);
-		auto t46 = new Tile4_Call;
-		all.push_back(t46);
+		if(!plain) {
+			auto t31 = Make<Tile3_PP>("Tile3_PP");
+			all.add(t31, {Op::addn, Op::subn});
+			auto t32 = Make<Tile3_SelfOp>("Tile3_SelfOp");
+			all.add(t32, {Op::add, Op::addn, Op::sub, Op::subn, Op::mult, Op::multn,
+			        Op::band, Op::bandn, Op::s_l, Op::s_ln, Op::s_r, Op::s_rn});
+		}
+
+		/* basics that do not overlap, the ones of ret, br, label and call are the only tiles of their Op */
+		auto t41 = Make<Tile4_AopSop>("Tile4_AopSop", true);
+		all.add(t41, {Op::add, Op::addn, Op::sub, Op::subn, Op::mult, Op::multn,
+		        Op::band, Op::bandn, Op::s_l, Op::s_ln, Op::s_r, Op::s_rn});
+		auto t42 = Make<Tile4_Asmt>("Tile4_Asmt", true);
+		all.add(t42, {Op::asmt});
+		auto t43 = Make<Tile4_Cmp>("Tile4_Cmp", true);
+		all.add(t43, {Op::c_l, Op::c_le, Op::c_e});
+		auto t44 = Make<Tile4_Ret>("Tile4_Ret");
+		all.add(t44, {Op::ret});
+		auto t45 = Make<Tile4_Label>("Tile4_Label");
+		all.add(t45, {Op::br, Op::label});
+		auto t46 = Make<Tile4_Call>("Tile4_Call");
+		all.add(t46, {Op::call});
 	}
 
 
@@ -136,514 +448,545 @@ namespace L3 {
       return "ERROR!";
 	}
 
-    std::string ItemPrinter(Item* i) {
+    std::string ItemPrinter(Program& p, Item i) {
 		std::string s;
 		s += " ";
-		if (i->type == VAR) {
-			s += "%v" + std::to_string(i->getval());
-		} else if (i->type == NUM) {
-			s += std::to_string(i->getval());
-		} else if (i->type == LABEL) {
-			s += ":l" + std::to_string(i->getval());
+		if (i.type == VAR) {
+			s += "%v" + std::to_string(i.getval());
+		} else if (i.type == NUM) {
+			s += std::to_string(i.getval());
+		} else if (i.type == LABEL) {
+			s += ":l" + std::to_string(i.getval());
 		} else {
-			s += dynamic_cast<FunName*>(i)->fun;
+			s += p.fun_names[i.getval()];
 		}
 		s += " ";
 		return s;
 	}
 
-	void SubTreeRecursion(Tree* t, Pattern* p, std::vector<Tile*>& howToDo) {
-		if (t->op != Op::leaf) {
-			p->leaves.push_back(Cover(t, howToDo));
-		}
-	}
-
-	void LeavesRecursion(Tree* t, std::vector<Tile*>& dummy, Tile* tile) {
-		if (t->leaves.size()) {
-			for (auto leaf : t->leaves) {
-				tile->try_to_cover(leaf, dummy);
-			}
-		}
-	}
-
-
 	/*
 	 * Tiles.
 	 */
-	std::string Tile1_EncDec::printer() { return ""; }                       // eliminate the contiguous encoding/decoding
-	Pattern* Tile1_EncDec::try_to_cover(Tree *i, std::vector<Tile*>& all) {  // [ v <<= 1 ][ v += 1 ][ v >>= 1 ]
-		if (i->op == s_rn && i->leaves.back()->root->getval() == 1) {
-			auto j = i->leaves.front();
-			if (j->op == addn && j->leaves.back()->root->getval() == 1) {
-				auto k = j->leaves.front();
-				if (k->op == s_ln && k->leaves.back()->root->getval() == 1) {
-					i->leaves.front() = k->leaves.front();
-					i->leaves.pop_back();
-					i->op = Op::asmt;
-				}
-			}
+	bool Tile1_AsmtInTree::rewrite(Function* f, Node i) {  // eliminate the assignments inside a tree [ a <- b ]
+		auto& T = f->trees;
+		if (T.op[i] == asmt && T.op[T.left[i]] != leaf && T.root[T.left[i]].type == VAR) {
+			auto j = T.left[i];
+			T.op[i] = T.op[j];
+			T.left[i] = T.left[j];
+			T.right[i] = T.right[j];
+			return true;
 		}
-		LeavesRecursion(i, all, this);
-		return NULL;
+		return false;
 	}
 
 
-	std::string Tile1_AsmtInTree::printer() { return ""; }                       // eliminate the assignments inside a tree
-	Pattern* Tile1_AsmtInTree::try_to_cover(Tree* i, std::vector<Tile*>& all) {  // [ a <- b ]
-		if (i->op == asmt && i->leaves.front()->op != leaf && i->leaves.front()->root->type == VAR) {
-			i->op = i->leaves.front()->op;
-			i->leaves = i->leaves.front()->leaves;
-			try_to_cover(i, all);
-		} else {
-			LeavesRecursion(i, all, this);
-		}
-		return NULL;
-	}
-
-
-	std::string Tile1_SameLeftVarInTree::printer() { return ""; }                       // assign a same name to the left vars in a tree as the root 
-	Pattern* Tile1_SameLeftVarInTree::try_to_cover(Tree *i, std::vector<Tile*>& all) {
-		if (i->op <= s_rn && i->leaves.front()->op != leaf) {
-			if (i->root->type != i->leaves.back()->root->type 
-			 || i->root->getval() != i->leaves.back()->root->getval()) {
-			    if (i->leaves.front()->leaves.size() == 1 
-				 || i->leaves.front()->leaves.back()->root->type != i->root->type 
-				 || i->leaves.front()->leaves.back()->root->getval() != i->root->getval()) {
-					i->leaves.front()->root = i->root;
+	bool Tile1_SameLeftVarInTree::rewrite(Function* f, Node i) {  // assign a same name to the left vars in a tree as the root
+		auto& T = f->trees;
+		if (T.op[i] <= s_rn && T.op[T.left[i]] != leaf) {
+			auto j = T.left[i];
+			if (T.root[i] != T.root[T.back(i)] && T.root[j] != T.root[i]) {
+			    if (T.size(j) == 1
+				 || T.root[T.back(j)] != T.root[i]) {
+					T.root[j] = T.root[i];
+					return true;
 				}
 			}
 		}
-		LeavesRecursion(i, all, this);
-		return NULL;
+		return false;
 	}
 
 
-	std::string Tile1_IniMult::printer() { return ""; }                       // mult following initialization of 1
-	Pattern* Tile1_IniMult::try_to_cover(Tree *i, std::vector<Tile*>& all) {
-		if (i->op == mult && i->leaves.front()->op == mult) {
-			auto j = i->leaves.front()->leaves.front();
-			if (j->op == asmt && j->leaves.front()->root->type == NUM && j->leaves.front()->root->getval() == 1) {
-				i->leaves.front() = i->leaves.front()->leaves.back();
-			}
-		}
-		LeavesRecursion(i, all, this);
-		return NULL;
-	}
-
-
-	std::string Tile1_ConsecMultn::printer() { return ""; }                       // pre-process the consecutive multiplications by constants
-	Pattern* Tile1_ConsecMultn::try_to_cover(Tree* i, std::vector<Tile*>& all) {  // [ *|<< ]
+	bool Tile1_ConsecMultn::rewrite(Function* f, Node i) {  // pre-process the consecutive multiplications by constants [ *|<< ]
+		auto& T = f->trees;
 		int64_t multiplier = 1;
 		int64_t bitwiser = 0;
+		int chain = 0;
 		auto iterator = i;
 
-		while (iterator->op == Op::multn || iterator->op == Op::s_ln) {
-			if (iterator->op == Op::multn) {
-				multiplier *= iterator->leaves.back()->root->getval();
+		while (T.op[iterator] == Op::multn || T.op[iterator] == Op::s_ln) {
+			if (T.op[iterator] == Op::multn) {
+				multiplier *= T.root[T.back(iterator)].getval();
 			} else {
-				bitwiser += iterator->leaves.back()->root->getval();
+				bitwiser += T.root[T.back(iterator)].getval();
 			}
-			iterator = iterator->leaves.front();
+			iterator = T.left[iterator];
+			chain++;
 		}
 
-		auto numM = new Num(multiplier);
-		auto leafM = new Tree(numM, Op::leaf);
-		auto numB = new Num(bitwiser);
-		auto leafB = new Tree(numB, Op::leaf);
-
 		if (multiplier == 1 && bitwiser > 0) {
-			i->leaves.front() = iterator;
-			i->leaves.back() = leafB;
+			if (chain == 1) {
+				return false;  // nothing left to fold
+			}
+			auto leafB = T.make(Num(bitwiser), Op::leaf);
+			T.op[i] = Op::s_ln;
+			T.left[i] = iterator;
+			T.right[i] = leafB;
 		} else if (multiplier > 1 && bitwiser == 0) {
-			i->leaves.front() = iterator;
-			i->leaves.back() = leafM;
+			if (chain == 1) {
+				return false;
+			}
+			auto leafM = T.make(Num(multiplier), Op::leaf);
+			T.op[i] = Op::multn;
+			T.left[i] = iterator;
+			T.right[i] = leafM;
 		} else if (multiplier > 1 && bitwiser > 0) {
-			i->op = Op::s_ln;
-			i->leaves.back() = leafB;
-			i->leaves.front()->op = Op::multn;
-			i->leaves.front()->leaves.back() = leafM;
-			i->leaves.front()->leaves.front() = iterator;
+			if (chain == 2 && T.op[i] == Op::s_ln) {
+				return false;
+			}
+			auto leafB = T.make(Num(bitwiser), Op::leaf);
+			auto leafM = T.make(Num(multiplier), Op::leaf);
+			auto j = T.left[i];
+			T.op[i] = Op::s_ln;
+			T.right[i] = leafB;
+			T.op[j] = Op::multn;
+			T.right[j] = leafM;
+			T.left[j] = iterator;
+		} else {
+			return false;
 		}
-
-		LeavesRecursion(iterator, all, this);
-		return NULL;
+		return true;
 	}
 
 
-	std::string Tile1_Addn::printer() { return ""; }                       // LA::[ a <- b + const ] --> L3::[ a <- b + 2*const ]
-	Pattern* Tile1_Addn::try_to_cover(Tree *i, std::vector<Tile*>& all) {
-		if (i->op == addn && i->leaves.back()->root->getval() == 1) {
-			auto j = i->leaves.front();
-			if (j->op == s_ln && j->leaves.back()->root->getval() == 1) {
-				auto k = j->leaves.front();
-				if (k->op == addn) {
-					int64_t n = k->leaves.back()->root->getval();
-					auto l = k->leaves.front();
-					if (l->op == s_rn && l->leaves.back()->root->getval() == 1) {
-						auto m = l->leaves.front();
-						auto item = new Num(2 * n);
-						auto num = new Tree(item, Op::leaf);
-						i->leaves.back() = num;
-						i->leaves.front() = m;
-					}
-				}
+	std::string Tile2_Lea::printer(Program& p, Function* f, const Match& m) {  // lea : [ w1 @ w2 w3 E ]
+	  return ItemPrinter(p, m.items[0]) + "@" + ItemPrinter(p, m.items[1]) + ItemPrinter(p, m.items[2]) + std::to_string(m.n) + "\n";
+    }
+	int Tile2_Lea::cover(Function* f, Node i, Match& m, std::vector<Node>& kids) {
+      auto& T = f->trees;
+      if(T.op[i] == Op::add) {
+		  auto l = T.left[i];
+		  auto r = T.back(i);
+		  if (T.op[r] == Op::s_ln) { auto temp = r; r = l; l = temp; }
+		  if (T.op[l] == Op::s_ln) {
+		      int64_t n = T.root[T.back(l)].getval();
+			  if (n == 1 || n == 2 || n == 3) {
+				  m.items[0] = T.root[i];
+				  m.items[1] = T.root[r];
+				  m.items[2] = T.root[T.left[l]];
+				  m.n = n == 1 ? 2 : n == 2 ? 4 : 8;
+				  kids.push_back(T.left[l]);
+				  kids.push_back(r);
+				  return LEA_COST;
+			  }
+		  }
+      }
+      return -1;
+    }
+
+
+	std::string Tile2_Lea::variant(const Match& m) {
+	  return "E " + std::to_string(m.n);
+    }
+
+
+	/*
+	 * w <- x * C as at most three moves, leas, shifts and adds, searched backward from C for the
+	 * cheapest under the cost table, or w *= C when nothing beats it
+	 *   once w is written x is gone when it is w itself, and a constant x can not go in a lea
+	 */
+	class MulStep {
+	  public:
+		enum Kind {ZERO, MOVE, LEA_XX, LEA_WW, LEA_WX, LEA_XW, SHL, ADD_X, SUB_X, MUL};
+		Kind kind;
+		int64_t n;
+	};
+
+	class MulPlan {
+	  public:
+		std::vector<MulStep> steps;   // in the order they are printed
+		int cost = INT32_MAX;
+	};
+
+	static void MulSearch(int64_t c, int left, bool same, bool var, std::vector<MulStep>& rev, int cost, MulPlan& best) {
+		auto done = [&](std::vector<MulStep> first, int c1) {  // first instructions of the plan, rev the rest backward
+			int total = cost + c1;
+			int size = first.size() + rev.size();
+			if(total < best.cost || (total == best.cost && size < (int)best.steps.size())) {
+				best.cost = total;
+				best.steps = first;
+				best.steps.insert(best.steps.end(), rev.rbegin(), rev.rend());
+			}
+		};
+		auto step = [&](MulStep::Kind kind, int64_t n, int64_t pred, int c1) {
+			rev.push_back({kind, n});
+			MulSearch(pred, left - 1, same, var, rev, cost + c1, best);
+			rev.pop_back();
+		};
+
+		if(c == 1) {
+			if(same) {
+				done({}, 0);
+			} else if(left >= 1) {
+				done({{MulStep::MOVE, 0}}, MOVE_COST);
 			}
 		}
-		LeavesRecursion(i, all, this);
-		return NULL;
+		if(left < 1) {
+			return;
+		}
+		if(var && (c == 2 || c == 3 || c == 5 || c == 9)) {
+			done({{MulStep::LEA_XX, c - 1}}, LEA_COST);
+		}
+		if(left < 2) {
+			return;
+		}
+		for(int k = 1; k < 63 && c % (int64_t(1) << k) == 0; k++) {
+			step(MulStep::SHL, k, c >> k, ALU_COST);
+		}
+		for(int64_t E : {1, 2, 4, 8}) {
+			if(c % (1 + E) == 0) {
+				step(MulStep::LEA_WW, E, c / (1 + E), LEA_COST);
+			}
+			if(!same && var && c - E >= 1) {
+				step(MulStep::LEA_WX, E, c - E, LEA_COST);
+			}
+			if(!same && var && E > 1 && (c - 1) % E == 0 && c > 1) {
+				step(MulStep::LEA_XW, E, (c - 1) / E, LEA_COST);
+			}
+		}
+		if(!same && c > 1) {
+			step(MulStep::ADD_X, 0, c - 1, ALU_COST);
+		}
+		if(!same && c < INT64_MAX) {
+			step(MulStep::SUB_X, 0, c + 1, ALU_COST);
+		}
 	}
 
-
-	std::string Tile1_Add::printer() { return ""; }                       // LA::[ a <- b + c ] --> L3::[ a <- b + c ][ a-- ]
-	Pattern* Tile1_Add::try_to_cover(Tree *i, std::vector<Tile*>& all) {
-		if (i->op == addn && i->leaves.back()->root->getval() == 1) {
-			auto j = i->leaves.front();
-			if (j->op == s_ln && j->leaves.back()->root->getval() == 1) {
-				auto k = j->leaves.front();
-				if (k->op == add) {
-					auto m = k->leaves.front();
-					auto n = k->leaves.back();
-					if (m->op == s_rn && m->leaves.back()->root->getval() == 1 && n->op == s_rn && n->leaves.back()->root->getval() == 1) {
-						auto p = m->leaves.front();
-						auto q = n->leaves.front();
-						if (p->op != subn && q->op != subn) {
-							i->op = subn;
-							auto r = i->leaves.front();
-							r->op = add;
-							r->leaves.front() = p;
-							r->leaves.back() = q;
-						}
-					}
-				}
+	static const MulPlan& PlanMul(int64_t c, bool same, bool var) {
+		static std::map<std::pair<int64_t, int>, MulPlan> plans;
+		auto& plan = plans[{c, same * 2 + var}];
+		if(plan.steps.empty() && plan.cost == INT32_MAX) {
+			if(same) {
+				plan.steps = {{MulStep::MUL, c}};
+				plan.cost = MULT_COST;
+			} else {
+				plan.steps = {{MulStep::MOVE, 0}, {MulStep::MUL, c}};
+				plan.cost = MOVE_COST + MULT_COST;
+			}
+			if(c == 0) {
+				plan.steps = {{MulStep::ZERO, 0}};
+				plan.cost = MOVE_COST;
+			} else if(c > 0) {
+				std::vector<MulStep> rev;
+				MulSearch(c, 3, same, var, rev, 0, plan);
 			}
 		}
-		LeavesRecursion(i, all, this);
-		return NULL;
+		return plan;
 	}
 
-
-	Tile2_Lea::Tile2_Lea(Item* w1, Item* w2, Item* w3, int64_t E)  // lea : [ w1 @ w2 w3 E ]
-	  : w1 {w1}, w2 {w2}, w3 {w3}, E {E} {}
-	std::string Tile2_Lea::printer() { 
-	  return ItemPrinter(w1) + "@" + ItemPrinter(w2) + ItemPrinter(w3) + std::to_string(E) + "\n";
+	int Tile2_MulConst::cover(Function* f, Node i, Match& m, std::vector<Node>& kids) {
+      auto& T = f->trees;
+      if(T.op[i] == Op::multn) {
+		  m.items[0] = T.root[i];
+		  m.items[1] = T.root[T.left[i]];
+		  m.n = T.root[T.back(i)].getval();
+		  kids.push_back(T.left[i]);
+		  return PlanMul(m.n, m.items[0] == m.items[1], m.items[1].type == VAR).cost;
+      }
+      return -1;
     }
-	Pattern* Tile2_Lea::try_to_cover(Tree *i, std::vector<Tile*>& all) { 
-      if(i->op == Op::add) {
-		  auto l = i->leaves.front();
-		  auto r = i->leaves.back();
-
-		  Pattern* p;
-		  auto recursivelyCoverSubTrees = [&](Tree* i1) {
-			  if (i1->op != Op::leaf) {
-					  p->leaves.push_back(Cover(i1, all));
-			  }
-		  };
-
-		  if (r->op == Op::s_ln) { auto temp = r; r = l; l = temp; }
-		  if (l->op == Op::s_ln) { 
-		      int64_t n = l->leaves.back()->root->getval();
-			  if (n == 1 || n == 2 || n == 3) {
-				  int64_t E = n == 1 ? 2 : n == 2 ? 4 : 8;
-				  auto t = new Tile2_Lea(i->root, r->root, l->leaves.front()->root, E);
-		          p = new Pattern(t);
-			      recursivelyCoverSubTrees(l->leaves.front());
-			      recursivelyCoverSubTrees(r);
-			      return p;
-			  }
+	std::string Tile2_MulConst::printer(Program& p, Function* f, const Match& m) {  // [ w <- x ][ w @ w w 2 ][ w <<= 1 ] ...
+	  auto w = ItemPrinter(p, m.items[0]);
+	  auto x = ItemPrinter(p, m.items[1]);
+	  std::string s;
+	  for(auto& step : PlanMul(m.n, m.items[0] == m.items[1], m.items[1].type == VAR).steps) {
+		  auto n = std::to_string(step.n);
+		  switch(step.kind) {
+			case MulStep::ZERO :   s += w + "<- 0\n"; break;
+			case MulStep::MOVE :   s += w + "<-" + x + "\n"; break;
+			case MulStep::LEA_XX : s += w + "@" + x + x + n + "\n"; break;
+			case MulStep::LEA_WW : s += w + "@" + w + w + n + "\n"; break;
+			case MulStep::LEA_WX : s += w + "@" + w + x + n + "\n"; break;
+			case MulStep::LEA_XW : s += w + "@" + x + w + n + "\n"; break;
+			case MulStep::SHL :    s += w + "<<= " + n + "\n"; break;
+			case MulStep::ADD_X :  s += w + "+=" + x + "\n"; break;
+			case MulStep::SUB_X :  s += w + "-=" + x + "\n"; break;
+			case MulStep::MUL :    s += w + "*= " + n + "\n"; break;
 		  }
-      }
-      return NULL;
+	  }
+	  return s;
+    }
+	std::string Tile2_MulConst::variant(const Match& m) {
+	  auto& plan = PlanMul(m.n, m.items[0] == m.items[1], m.items[1].type == VAR);
+	  return !plan.steps.empty() && plan.steps.back().kind == MulStep::MUL ? "*=" : std::to_string(plan.steps.size()) + " steps";
     }
 
 
-	Tile2_Cjump::Tile2_Cjump(Item* t1, Op cmp, Item* t2, Item* label)  // cjump : [ cjump t1 cmp t2 label ]
-      : t1 {t1}, t2 {t2}, cmp {cmp}, label {label} {}
-	std::string Tile2_Cjump::printer() {
-	  return " cjump" + ItemPrinter(t1) + OpPrinter(cmp) + ItemPrinter(t2) + ItemPrinter(label) + "\n";
+	std::string Tile2_Cjump::printer(Program& p, Function* f, const Match& m) {  // cjump : [ cjump t1 cmp t2 label ]
+	  return " cjump" + ItemPrinter(p, m.items[0]) + OpPrinter(m.op) + ItemPrinter(p, m.items[1]) + ItemPrinter(p, m.items[2]) + "\n";
     }
-	Pattern* Tile2_Cjump::try_to_cover(Tree *i, std::vector<Tile*>& all) { 
-      if(i->op == Op::cjmp) {
-		  Tile2_Cjump* t;
-		  Pattern* p;
-		  auto recursivelyCoverSubTrees = [&](Tree* T) {
-			  if (T->op != Op::leaf) {
-					  p->leaves.push_back(Cover(T, all));
-			  }
-		  };
-
-		  auto cond = i->leaves.front();
-		  if (cond->op <= c_e && cond->op >= c_l) {
-			  auto t1 = cond->leaves.front();
-			  auto t2 = cond->leaves.back();
-			  if (t1->op == s_rn && t2->op == s_rn && t1->leaves.back()->root->getval() == t2->leaves.back()->root->getval()) {  // LA cmp
-				  t = new Tile2_Cjump(t1->leaves.front()->root, cond->op, t2->leaves.front()->root, i->root);
-				  p = new Pattern(t);
-				  recursivelyCoverSubTrees(t1->leaves.front());
-				  recursivelyCoverSubTrees(t2->leaves.front());
+	int Tile2_Cjump::cover(Function* f, Node i, Match& m, std::vector<Node>& kids) {
+      auto& T = f->trees;
+      if(T.op[i] == Op::cjmp) {
+		  auto cond = T.left[i];
+		  m.items[2] = T.root[i];
+		  if (T.op[cond] <= c_e && T.op[cond] >= c_l) {
+			  auto t1 = T.left[cond];
+			  auto t2 = T.back(cond);
+			  m.op = T.op[cond];
+			  if (T.op[t1] == s_rn && T.op[t2] == s_rn && T.root[T.back(t1)] == T.root[T.back(t2)]) {  // LA cmp
+				  m.items[0] = T.root[T.left[t1]];
+				  m.items[1] = T.root[T.left[t2]];
+				  m.n = 2;
+				  kids.push_back(T.left[t1]);
+				  kids.push_back(T.left[t2]);
 			  } else { // merged cjump
-				  t = new Tile2_Cjump(t1->root, cond->op, t2->root, i->root);
-				  p = new Pattern(t);
-				  recursivelyCoverSubTrees(t1);
-				  recursivelyCoverSubTrees(t2);
+				  m.items[0] = T.root[t1];
+				  m.items[1] = T.root[t2];
+				  m.n = 1;
+				  kids.push_back(t1);
+				  kids.push_back(t2);
 			  }
 		  } else {  // basic
-			  auto item = new Num(1);
-			  t = new Tile2_Cjump(cond->root, c_e, item, i->root);
-			  p = new Pattern(t);
-			  recursivelyCoverSubTrees(cond);
+			  m.items[0] = T.root[cond];
+			  m.op = c_e;
+			  m.items[1] = Num(1);
+			  m.n = 0;
+			  kids.push_back(cond);
 		  }
-		  return p;
+		  return BRANCH_COST;
       }
-      return NULL;
+      return -1;
     }
 
 
-	Tile2_LoadM::Tile2_LoadM(Item* w, Item* x, int64_t M)  // load : [ w <- mem x M ]
-      : w {w}, x {x}, M {M} {}
-	std::string Tile2_LoadM::printer() { 
-	  return ItemPrinter(w) + "<- mem" + ItemPrinter(x) + std::to_string(M) + "\n";
+	std::string Tile2_Cjump::variant(const Match& m) {
+	  return m.n == 2 ? "LA cmp" : m.n == 1 ? "merged" : "basic";
     }
-	Pattern* Tile2_LoadM::try_to_cover(Tree *i, std::vector<Tile*>& all) { 
-		if(i->op == Op::load) {
-			Tree* x = i->leaves.back();
+
+
+	std::string Tile2_LoadM::printer(Program& p, Function* f, const Match& m) {  // load : [ w <- mem x M ]
+	  return ItemPrinter(p, m.items[0]) + "<- mem" + ItemPrinter(p, m.items[1]) + std::to_string(m.n) + "\n";
+    }
+	int Tile2_LoadM::cover(Function* f, Node i, Match& m, std::vector<Node>& kids) {
+		auto& T = f->trees;
+		if(T.op[i] == Op::load) {
+			Node x = T.back(i);
 			int64_t M = 0;
 
-			if (x->op == Op::addn)  {
-				auto x2 = x->leaves.front();
-				int64_t M2 = x->leaves.back()->root->getval();
+			if (T.op[x] == Op::addn)  {
+				auto x2 = T.left[x];
+				int64_t M2 = T.root[T.back(x)].getval();
 				if (M2 % 8 == 0) {
 					x = x2;
 					M = M2;
 				}
 			}
 
-			auto t = new Tile2_LoadM(i->root, x->root, M);
-		    auto p = new Pattern(t);
-			SubTreeRecursion(x, p, all);
-			return p;
+			m.items[0] = T.root[i];
+			m.items[1] = T.root[x];
+			m.n = M;
+			kids.push_back(x);
+			return MOVE_COST;
 		}
-		return NULL;
+		return -1;
 	}
-	
 
-	Tile2_SroreM::Tile2_SroreM(Item* x, int64_t M, Item* s)  // store : [ mem x M <- s ]
-      : x {x}, M {M}, s {s} {}
-	std::string Tile2_SroreM::printer() { 
-	  return " mem" + ItemPrinter(x) + std::to_string(M) + " <-" + ItemPrinter(s) + "\n";
+
+	std::string Tile2_SroreM::printer(Program& p, Function* f, const Match& m) {  // store : [ mem x M <- s ]
+	  return " mem" + ItemPrinter(p, m.items[0]) + std::to_string(m.n) + " <-" + ItemPrinter(p, m.items[1]) + "\n";
     }
-	Pattern* Tile2_SroreM::try_to_cover(Tree *i, std::vector<Tile*>& all) { 
-		if(i->op == Op::store) {
-			Tree* x = i->leaves.front();
-			Tree* s = i->leaves.back();
+	int Tile2_SroreM::cover(Function* f, Node i, Match& m, std::vector<Node>& kids) {
+		auto& T = f->trees;
+		if(T.op[i] == Op::store) {
+			Node x = T.left[i];
+			Node s = T.back(i);
 			int64_t M = 0;
 
-			if (x->op == Op::addn)  {
-				auto x2 = x->leaves.front();
-				int64_t M2 = x->leaves.back()->root->getval();
+			if (T.op[x] == Op::addn)  {
+				auto x2 = T.left[x];
+				int64_t M2 = T.root[T.back(x)].getval();
 				if (M2 % 8 == 0) {
 					x = x2;
 					M = M2;
 				}
 			}
 
-			auto t = new Tile2_SroreM(x->root, M, s->root);
-		    auto p = new Pattern(t);
-			SubTreeRecursion(x, p, all);
-			SubTreeRecursion(s, p, all);
-			return p;
+			m.items[0] = T.root[x];
+			m.items[1] = T.root[s];
+			m.n = M;
+			kids.push_back(x);
+			kids.push_back(s);
+			return MOVE_COST;
 		}
-		return NULL;
+		return -1;
 	}
 
 
-    Tile3_PP::Tile3_PP(Item* w, Op op)  // self inc/dec : [ v(++|--) ]
-	  : w {w}, op {op} {}
-	std::string Tile3_PP::printer() {
-	  std::string s = op == Op::addn ? "++" : "--";
-	  return " %v" + std::to_string(w->getval()) + s + "\n";
+	std::string Tile3_PP::printer(Program& p, Function* f, const Match& m) {  // self inc/dec : [ v(++|--) ]
+	  std::string s = m.op == Op::addn ? "++" : "--";
+	  return " %v" + std::to_string(m.items[0].getval()) + s + "\n";
     }
-	Pattern* Tile3_PP::try_to_cover(Tree *i, std::vector<Tile*>& all) { 
-      if(i->op == Op::addn || i->op == Op::subn) {
-		  int64_t r = i->root->getval();
-		  int64_t r1 = i->leaves.front()->root->getval();
-		  if(r == r1 && i->leaves.back()->root->getval() == 1) {
-			  auto t = new Tile3_PP(i->root, i->op);
-              auto p = new Pattern(t);
-              SubTreeRecursion(i->leaves.front(), p, all);
-              return p;
+	int Tile3_PP::cover(Function* f, Node i, Match& m, std::vector<Node>& kids) {
+      auto& T = f->trees;
+      if(T.op[i] == Op::addn || T.op[i] == Op::subn) {
+		  if(T.root[i] == T.root[T.left[i]] && T.root[T.back(i)].getval() == 1) {
+			  m.items[0] = T.root[i];
+			  m.op = T.op[i];
+			  kids.push_back(T.left[i]);
+			  return ALU_COST;
 		  }
       }
-      return NULL;
+      return -1;
     }
 
 
-	Tile3_SelfOp::Tile3_SelfOp(Item* w, Op op, Item* t) // self aop/sop : [ v += t ]
-	  : w {w}, op {op}, t {t} {}
-	std::string Tile3_SelfOp::printer() {
-	  return ItemPrinter(w) + OpPrinter(op) + ItemPrinter(t) + "\n";
+	std::string Tile3_SelfOp::printer(Program& p, Function* f, const Match& m) {  // self aop/sop : [ v += t ]
+	  return ItemPrinter(p, m.items[0]) + OpPrinter(m.op) + ItemPrinter(p, m.items[1]) + "\n";
     }
-	Pattern* Tile3_SelfOp::try_to_cover(Tree *i, std::vector<Tile*>& all) { 
-      if(i->op <= Op::s_rn) {
-		  int64_t r = i->root->getval();
-		  int64_t r1 = i->leaves.front()->root->getval();
-		  if(i->root->type == i->leaves.front()->root->type && r == r1) {   // v = 1 - v
-			  auto t = new Tile3_SelfOp(i->root, i->op, i->leaves.back()->root);
-              auto p = new Pattern(t);
-			  SubTreeRecursion(i->leaves.front(), p, all);
-			  SubTreeRecursion(i->leaves.back(), p, all);
-              return p;
+	int Tile3_SelfOp::cover(Function* f, Node i, Match& m, std::vector<Node>& kids) {
+      auto& T = f->trees;
+      if(T.op[i] <= Op::s_rn) {
+		  if(T.root[i] == T.root[T.left[i]]) {   // v = 1 - v
+			  m.items[0] = T.root[i];
+			  m.op = T.op[i];
+			  m.items[1] = T.root[T.back(i)];
+			  kids.push_back(T.left[i]);
+			  kids.push_back(T.back(i));
+			  return OpCost(m.op);
 		  }
       }
-      return NULL;
+      return -1;
     }
 
-    
-	Tile4_AopSop::Tile4_AopSop(Item* w, Item* t1, Item* t2, Op op)  // aop/sop : [ a <- b ][ a += c ]
-	  : w {w}, t1 {t1}, t2 {t2}, op {op} {}
-	std::string Tile4_AopSop::printer() {
+
+	std::string Tile4_AopSop::printer(Program& p, Function* f, const Match& m) {  // aop/sop : [ a <- b ][ a += c ]
+	  auto w = m.items[0];
+	  auto t2 = m.items[2];
 	  std::string s;
-	  s += ItemPrinter(w) + "<-" + ItemPrinter(t1) + "\n";
-	  if (t2->type == NUM && t2->getval() == 1 && op == addn) {
-		  s += " %v" + std::to_string(w->getval()) + "++\n";
-	  } else if (t2->type == NUM && t2->getval() == 1 && op == subn) {
-		  s += " %v" + std::to_string(w->getval()) + "--\n";
+	  s += ItemPrinter(p, w) + "<-" + ItemPrinter(p, m.items[1]) + "\n";
+	  if (t2.type == NUM && t2.getval() == 1 && m.op == addn) {
+		  s += " %v" + std::to_string(w.getval()) + "++\n";
+	  } else if (t2.type == NUM && t2.getval() == 1 && m.op == subn) {
+		  s += " %v" + std::to_string(w.getval()) + "--\n";
 	  } else {
-		  s += ItemPrinter(w) + OpPrinter(op) + ItemPrinter(t2) + "\n";
+		  s += ItemPrinter(p, w) + OpPrinter(m.op) + ItemPrinter(p, t2) + "\n";
 	  }
 	  return s;
     }
-	Pattern* Tile4_AopSop::try_to_cover(Tree *i, std::vector<Tile*>& all) { 
-      if(i->op <= Op::s_rn) {
-		  auto t = new Tile4_AopSop(i->root, i->leaves.front()->root, i->leaves.back()->root, i->op);
-		  auto p = new Pattern(t);
-		  SubTreeRecursion(i->leaves.front(), p, all);
-		  SubTreeRecursion(i->leaves.back(), p, all);
-		  return p;
+	int Tile4_AopSop::cover(Function* f, Node i, Match& m, std::vector<Node>& kids) {
+      auto& T = f->trees;
+      if(T.op[i] <= Op::s_rn) {
+		  m.items[0] = T.root[i];
+		  m.items[1] = T.root[T.left[i]];
+		  m.items[2] = T.root[T.back(i)];
+		  m.op = T.op[i];
+		  kids.push_back(T.left[i]);
+		  kids.push_back(T.back(i));
+		  return MOVE_COST + OpCost(m.op);
       }
-      return NULL;
+      return -1;
     }
 
-    
-    Tile4_Asmt::Tile4_Asmt(Item* w, Item* s)   // assignment : [ v <- s ]
-	  : w {w}, s {s} {}
-	std::string Tile4_Asmt::printer() {
-	  return ItemPrinter(w) + "<-" + ItemPrinter(s) + "\n";
+
+	std::string Tile4_Asmt::printer(Program& p, Function* f, const Match& m) {  // assignment : [ v <- s ]
+	  return ItemPrinter(p, m.items[0]) + "<-" + ItemPrinter(p, m.items[1]) + "\n";
     }
-	Pattern* Tile4_Asmt::try_to_cover(Tree *i, std::vector<Tile*>& all) { 
-      if(i->op == Op::asmt) {
-		  auto t = new Tile4_Asmt(i->root, i->leaves.front()->root);
-          auto p = new Pattern(t);
-          SubTreeRecursion(i->leaves.front(), p, all);
-          return p;  
+	int Tile4_Asmt::cover(Function* f, Node i, Match& m, std::vector<Node>& kids) {
+      auto& T = f->trees;
+      if(T.op[i] == Op::asmt) {
+		  m.items[0] = T.root[i];
+		  m.items[1] = T.root[T.left[i]];
+		  kids.push_back(T.left[i]);
+		  return MOVE_COST;
       }
-      return NULL;
+      return -1;
     }
 
-    
-	Tile4_Cmp::Tile4_Cmp(Item* w, Item* t1, Item* t2, Op cmp)  // cmp : [ w <- t1 cmp t2 ]
-	  : w {w}, t1 {t1}, t2 {t2}, cmp {cmp} {}
-	std::string Tile4_Cmp::printer() {
-	  return ItemPrinter(w) + "<-" + ItemPrinter(t1) + OpPrinter(cmp) + ItemPrinter(t2) + "\n";
+
+	std::string Tile4_Cmp::printer(Program& p, Function* f, const Match& m) {  // cmp : [ w <- t1 cmp t2 ]
+	  return ItemPrinter(p, m.items[0]) + "<-" + ItemPrinter(p, m.items[1]) + OpPrinter(m.op) + ItemPrinter(p, m.items[2]) + "\n";
     }
-	Pattern* Tile4_Cmp::try_to_cover(Tree *i, std::vector<Tile*>& all) { 
-      if(i->op <= Op::c_e) {
-		  auto t = new Tile4_Cmp(i->root, i->leaves.front()->root, i->leaves.back()->root, i->op);
-		  auto p = new Pattern(t);
-		  SubTreeRecursion(i->leaves.front(), p, all);
-		  SubTreeRecursion(i->leaves.back(), p, all);
-		  return p;
+	int Tile4_Cmp::cover(Function* f, Node i, Match& m, std::vector<Node>& kids) {
+      auto& T = f->trees;
+      if(T.op[i] >= Op::c_l && T.op[i] <= Op::c_e) {   // the aop/sop below c_l are left to Tile4_AopSop
+		  m.items[0] = T.root[i];
+		  m.items[1] = T.root[T.left[i]];
+		  m.items[2] = T.root[T.back(i)];
+		  m.op = T.op[i];
+		  kids.push_back(T.left[i]);
+		  kids.push_back(T.back(i));
+		  return ALU_COST;
       }
-      return NULL;
+      return -1;
     }
 
 
-	Tile4_Ret::Tile4_Ret(Item* t)  // return
-	  : t {t} {}
-	std::string Tile4_Ret::printer() {
+	std::string Tile4_Ret::printer(Program& p, Function* f, const Match& m) {  // return
 	  std::string s;
-	  if(t) { s += " rax <-" + ItemPrinter(t) + "\n"; }
+	  if(m.items[0].type != NONE) { s += " rax <-" + ItemPrinter(p, m.items[0]) + "\n"; }
 	  s += " return\n";
 	  return s;
     }
-	Pattern* Tile4_Ret::try_to_cover(Tree *i, std::vector<Tile*>& all) { 
-      Pattern* p;
-      if(i->op == Op::ret) {
-		  Tile4_Ret* t;
-		  if (i->leaves.size()) {
-			  t = new Tile4_Ret(i->leaves.front()->root);
-			  p = new Pattern(t);
-			  SubTreeRecursion(i->leaves.front(), p, all);
-		  } else {
-			  t = new Tile4_Ret(NULL);
-			  p = new Pattern(t);
+	int Tile4_Ret::cover(Function* f, Node i, Match& m, std::vector<Node>& kids) {
+      auto& T = f->trees;
+      if(T.op[i] == Op::ret) {
+		  if (T.left[i] != NIL) {
+			  m.items[0] = T.root[T.left[i]];
+			  kids.push_back(T.left[i]);
+			  return MOVE_COST + BRANCH_COST;
 		  }
-		  return p;
+		  m.items[0] = Item();
+		  return BRANCH_COST;
       }
-      return NULL;
+      return -1;
     }
 
-    
-	Tile4_Label::Tile4_Label(Item* label, Op op) // goto/label
-	  : label {label}, op {op} {}
-    std::string Tile4_Label::printer() {
+
+    std::string Tile4_Label::printer(Program& p, Function* f, const Match& m) {  // goto/label
 	  std::string s;
-	  if(op == Op::br) { s += " goto"; }
-	  s += ItemPrinter(label) + "\n";
+	  if(m.op == Op::br) { s += " goto"; }
+	  s += ItemPrinter(p, m.items[0]) + "\n";
 	  return s;
     }
-	Pattern* Tile4_Label::try_to_cover(Tree *i, std::vector<Tile*>& all) {
-      if(i->op == Op::br || i->op == Op::label) {
-		  auto t = new Tile4_Label(i->root, i->op);
-		  auto p = new Pattern(t);
-		  return p;
+	int Tile4_Label::cover(Function* f, Node i, Match& m, std::vector<Node>& kids) {
+      auto& T = f->trees;
+      if(T.op[i] == Op::br || T.op[i] == Op::label) {
+		  m.items[0] = T.root[i];
+		  m.op = T.op[i];
+		  return BRANCH_COST;
       }
-      return NULL;
+      return -1;
     }
 
-    
-	Tile4_Call::Tile4_Call(Tree *t) // call
-	  : t {t} {}
-	Pattern* Tile4_Call::try_to_cover(Tree *i, std::vector<Tile*>& all) { 
-      if(i->op == Op::call) {
-		  auto t = new Tile4_Call(i);
-		  auto p = new Pattern(t);
-		  return p;
-      }
-      return NULL;
+
+	int Tile4_Call::cover(Function* f, Node i, Match& m, std::vector<Node>& kids) {  // call, printed from its tree
+      return f->trees.op[i] == Op::call ? BRANCH_COST : -1;   // the only tile of a call
     }
-    std::string Tile4_Call::printer() {
+    std::string Tile4_Call::printer(Program& p, Function* f, const Match& m) {
+	  auto& T = f->trees;
+	  auto t = m.node;
 	  std::string s;
 	  std::string callee;
 	  bool ifRt = false;
 	  std::vector<std::string> regs ({" rdi <-", " rsi <-", " rdx <-", " rcx <-", " r8 <-", " r9 <-"});
-	  int n = t->leaves.size() - 2;
+	  int n = T.size(t) - 2;
 	  int regarg = n > 6 ? 6 : n;
 	  int stackarg = n > 6 ? (n-6) : 0;
-	  
-	  callee = ItemPrinter(t->leaves.back()->root);
+
+	  callee = ItemPrinter(p, T.root[T.back(t)]);
 	  if(callee[1] != '@' && callee[1] != '%') {
 		  ifRt = true;
 	  }
-	  t->leaves.pop_back();
-	  
+	  Item rtLabel = T.root[T.leaf(t, n)];
+
 	  if(!ifRt) {
-		  s += " mem rsp -8 <-" + ItemPrinter(t->leaves.back()->root) + "\n";
+		  s += " mem rsp -8 <-" + ItemPrinter(p, rtLabel) + "\n";
 	  }
 	  for(int i = 0; i < regarg; ++i) {
-		  s += regs[i] + ItemPrinter((t->leaves)[i]->root) + "\n";
+		  s += regs[i] + ItemPrinter(p, T.root[T.leaf(t, i)]) + "\n";
 	  }
 	  for(int i = 0; i < stackarg; ++i) {
-		  s += " mem rsp " + std::to_string(-16 - 8 * i) + " <-" + ItemPrinter((t->leaves)[6 + i]->root) + "\n";
+		  s += " mem rsp " + std::to_string(-16 - 8 * i) + " <-" + ItemPrinter(p, T.root[T.leaf(t, 6 + i)]) + "\n";
 	  }
-	  
+
 	  s += " call" + callee + std::to_string(n) + "\n";
-	  
+
 	  if(!ifRt) {
-		  s += ItemPrinter(t->leaves.back()->root) + "\n";
+		  s += ItemPrinter(p, rtLabel) + "\n";
 	  }
-	  
-	  if(t->root != NULL) {
-		  s += ItemPrinter(t->root) + "<- rax" + "\n";
+
+	  if(T.root[t].type != NONE) {
+		  s += ItemPrinter(p, T.root[t]) + "<- rax" + "\n";
 	  }
 	  return s;
     }
@@ -1,222 +1,212 @@
 #pragma once
 
+#include <map>
+#include <ostream>
+#include <string>
+
 #include <L3.h>
+#include <lvn.h>
+#include <passes.h>
+#include <pattern.h>
 
 namespace L3{
 
-  void MaximalMunch(Program &p);
-
-  class Tile1_EncDec: public Tile {
-        public:
-        Tile1_EncDec(){};
+  /*
+   * tiles in the order they are tried, and the ones able to match each root Op
+   *   a node is only offered to the candidates of its Op
+   */
+  class TileSet {
+    public:
+      void add(Tile* t, std::initializer_list<Op> roots);
 
-        Pattern* try_to_cover(Tree *i, std::vector<Tile*>& all) override;
-        std::string printer() override;
+      std::vector<Tile*> tiles;
+      std::vector<Tile*> candidates[Op::leaf + 1];
   };
 
-  class Tile1_AsmtInTree: public Tile {
-        public:
-        Tile1_AsmtInTree(){};
+  /* cost table of the L2 instructions printed by the tiles, in cycles, Label minimizes their sum */
+  const int MOVE_COST = 1;     // <-, loads and stores
+  const int ALU_COST = 1;      // += -= &= <<= >>=, ++ --, compares
+  const int LEA_COST = 1;      // @
+  const int MULT_COST = 3;     // *=, the latency of an imul
+  const int BRANCH_COST = 1;   // cjump, goto, call, return
 
-        Pattern* try_to_cover(Tree *i, std::vector<Tile*>& all) override;
-        std::string printer() override;
-  };
+  inline int OpCost(Op op) { return op == Op::mult || op == Op::multn ? MULT_COST : ALU_COST; }
 
-  class Tile1_SameLeftVarInTree: public Tile {
-        public:
-        Tile1_SameLeftVarInTree(){};
+  class TileStats {
+    public:
+      std::string name;
+      bool basic = false;          // a Tile4 with better tiles for the same Op, what is left when none matches
+      int64_t attempts = 0;        // calls to cover, labeling and covering, or to rewrite
+      int64_t matches = 0;         // of which matched, or changed the tree
+      int64_t chosen = 0;          // matches kept in the final cover
+      int64_t matched_ns = 0;      // time in the calls that matched
+      int64_t failed_ns = 0;       // and in the ones that did not
+      std::map<std::string, int64_t> variants;   // chosen matches by Tile::variant
+  };
+
+  /*
+   * what each tile did on the program, nothing is counted unless enabled,
+   * shapes counts the trees a basic tile was chosen for, two levels deep, the candidates for new tiles
+   */
+  class TileProfile {
+    public:
+      void print(std::ostream& out);
 
-        Pattern* try_to_cover(Tree *i, std::vector<Tile*>& all) override;
-        std::string printer() override;
+      bool enabled = false;
+      std::vector<TileStats> tiles;   // by Tile::id
+      std::map<std::string, int64_t> shapes;
   };
 
-  class Tile1_IniMult: public Tile {
-        public:
-        Tile1_IniMult(){};
+  /* plain: one L2 instruction per tree node, no simplification and no value numbering, which goes down the dominators of a when given */
+  void MaximalMunch(Program &p, bool plain, LvnStats& values, TileProfile* profile = NULL, Analyses* a = NULL);
 
-        Pattern* try_to_cover(Tree *i, std::vector<Tile*>& all) override;
-        std::string printer() override;
-  };
+  /* plain tiles at -O0, the simplifiers, the value numbering of each context and the multi-level tiles from -O1,
+     the value numbering of each function down its dominator tree from -O2 */
+  class TilePass : public Pass {
+    public:
+      TilePass () : Pass ("tile", 0, {}, 0) {}
 
-  class Tile1_ConsecMultn: public Tile {
-        public:
-        Tile1_ConsecMultn(){};
+      void run(Program& p, Analyses& a, int optLevel) override;
 
-        Pattern* try_to_cover(Tree *i, std::vector<Tile*>& all) override;
-        std::string printer() override;
+      TileProfile profile;
+      LvnStats values;
   };
 
-  class Tile1_Addn : public Tile {
-      public:
-      Tile1_Addn(){};
-  
-      Pattern* try_to_cover(Tree *i, std::vector<Tile*>& all) override;
-      std::string printer() override;
+  /* a simplifier declared by its rule */
+  template <typename R>
+  class Simplifier : public Tile {
+    public:
+      bool rewrite(Function* f, Node i) override { return R::apply(f->trees, i); }
   };
 
-  class Tile1_Add : public Tile {
-      public:
-      Tile1_Add(){};
-      
-      Pattern* try_to_cover(Tree *i, std::vector<Tile*>& all) override;
-      std::string printer() override;
-  };
+  namespace rules {
+    using namespace pattern;
 
-  class Tile2_Lea : public Tile {
-    public:
-      Tile2_Lea(){};
+    /* eliminate the contiguous encoding/decoding [ v <<= 1 ][ v += 1 ][ v >>= 1 ] */
+    using EncDec = Rule<Tree<Op::s_rn, Tree<Op::addn, Tree<Op::s_ln, Bind<1>, Const<1>>, Const<1>>, Const<1>>,
+                        Edit<0, Op::asmt, Ref<1>>>;
+
+    /* mult following initialization of 1 */
+    using IniMult = Rule<Tree<Op::mult, Tree<Op::mult, Tree<Op::asmt, Const<1>>, Bind<1>>, Bind<2>>,
+                         Edit<0, Op::mult, Ref<1>, Ref<2>>>;
 
-      Tile2_Lea(Item* w1, Item* w2, Item* w3, int64_t E);
-      Item* w1;
-	  Item* w2;
-	  Item* w3;
-	  int64_t E;
+    /* LA::[ a <- b + const ] --> L3::[ a <- b + 2*const ] */
+    using Addn = Rule<Tree<Op::addn, Tree<Op::s_ln, Tree<Op::addn, Tree<Op::s_rn, Bind<1>, Const<1>>, Bind<2>>, Const<1>>, Const<1>>,
+                      Edit<0, Op::addn, Ref<1>, Scaled<2, 2>>>;
 
-      Pattern* try_to_cover(Tree *i, std::vector<Tile*>& all) override;
-      std::string printer() override;
+    /* LA::[ a <- b + c ] --> L3::[ a <- b + c ][ a-- ] */
+    using Add = Rule<Tree<Op::addn, Bind<1, Tree<Op::s_ln, Tree<Op::add, Tree<Op::s_rn, Bind<2, NotOp<Op::subn>>, Const<1>>,
+                                                                       Tree<Op::s_rn, Bind<3, NotOp<Op::subn>>, Const<1>>>, Const<1>>>,
+                                  Bind<4, Const<1>>>,
+                     Edit<0, Op::subn, Edit<1, Op::add, Ref<2>, Ref<3>>, Ref<4>>>;
+  }
+
+  /*
+   * the tiles hold no state, one of each serves every tree of the program,
+   * what a match prints lives in its Match record
+   */
+  using Tile1_EncDec = Simplifier<rules::EncDec>;
+
+  class Tile1_AsmtInTree: public Tile {
+        public:
+        bool rewrite(Function* f, Node i) override;
   };
 
-  class Tile2_Cjump : public Tile {
-    public :
-      Tile2_Cjump(){};
+  class Tile1_SameLeftVarInTree: public Tile {
+        public:
+        bool rewrite(Function* f, Node i) override;
+  };
 
-      Tile2_Cjump(Item* t1, Op cmp, Item* t2, Item* label);
-      Item* label;
-	  Item* t1;
-      Item* t2;
-      Op cmp;
+  using Tile1_IniMult = Simplifier<rules::IniMult>;
 
-      Pattern* try_to_cover(Tree *i, std::vector<Tile*>& all) override;
-      std::string printer() override;
+  class Tile1_ConsecMultn: public Tile {
+        public:
+        bool rewrite(Function* f, Node i) override;
   };
 
-  class Tile2_LoadM : public Tile {
+  using Tile1_Addn = Simplifier<rules::Addn>;
+  using Tile1_Add = Simplifier<rules::Add>;
+
+  class Tile2_Lea : public Tile {   // items: w1 w2 w3, n: E
     public:
-      Tile2_LoadM(){};
+      int cover(Function* f, Node i, Match& m, std::vector<Node>& kids) override;
+      std::string printer(Program& p, Function* f, const Match& m) override;
+      std::string variant(const Match& m) override;
+  };
 
-      Tile2_LoadM(Item* w, Item* x, int64_t M);
-      Item* w;
-	  Item* x;
-	  int64_t M;
+  class Tile2_MulConst : public Tile {   // items: w x, n: the constant, a multiplication as leas, shifts and adds
+    public:
+      int cover(Function* f, Node i, Match& m, std::vector<Node>& kids) override;
+      std::string printer(Program& p, Function* f, const Match& m) override;
+      std::string variant(const Match& m) override;
+  };
 
-      Pattern* try_to_cover(Tree *i, std::vector<Tile*>& all) override;
-      std::string printer() override;
+  class Tile2_Cjump : public Tile {   // items: t1 t2 label, op: cmp, n: 0 basic, 1 merged, 2 LA cmp
+    public :
+      int cover(Function* f, Node i, Match& m, std::vector<Node>& kids) override;
+      std::string printer(Program& p, Function* f, const Match& m) override;
+      std::string variant(const Match& m) override;
+  };
 
+  class Tile2_LoadM : public Tile {   // items: w x, n: M
+    public:
+      int cover(Function* f, Node i, Match& m, std::vector<Node>& kids) override;
+      std::string printer(Program& p, Function* f, const Match& m) override;
   };
 
 
-  class Tile2_SroreM : public Tile {
+  class Tile2_SroreM : public Tile {   // items: x s, n: M
     public:
-      Tile2_SroreM(){};
-
-      Tile2_SroreM(Item* x, int64_t M, Item* s);
-      Item* x;
-	  int64_t M;
-	  Item* s;
-  
-      Pattern* try_to_cover(Tree *i, std::vector<Tile*>& all) override;
-      std::string printer() override;
+      int cover(Function* f, Node i, Match& m, std::vector<Node>& kids) override;
+      std::string printer(Program& p, Function* f, const Match& m) override;
   };
   
-  class Tile3_PP : public Tile {
+  class Tile3_PP : public Tile {   // items: w, op
     public :
-      Tile3_PP(){};
-
-      Tile3_PP(Item* w, Op op); 
-      Item* w;
-      Op op;
-      
-      Pattern* try_to_cover(Tree *i, std::vector<Tile*>& all) override;
-      std::string printer() override;
+      int cover(Function* f, Node i, Match& m, std::vector<Node>& kids) override;
+      std::string printer(Program& p, Function* f, const Match& m) override;
   };
 
-  class Tile3_SelfOp : public Tile {
+  class Tile3_SelfOp : public Tile {   // items: w t, op
     public :
-      Tile3_SelfOp(){};
-
-      Tile3_SelfOp(Item* w, Op op, Item* t);
-      Item* w;
-	  Op op;
-	  Item* t;
-
-      Pattern* try_to_cover(Tree *i, std::vector<Tile*>& all) override;
-      std::string printer() override;
+      int cover(Function* f, Node i, Match& m, std::vector<Node>& kids) override;
+      std::string printer(Program& p, Function* f, const Match& m) override;
   };
 
-  class Tile4_AopSop : public Tile {
+  class Tile4_AopSop : public Tile {   // items: w t1 t2, op
     public :
-      Tile4_AopSop(){};
-
-      Tile4_AopSop(Item* w, Item* t1, Item* t2, Op op);
-      int64_t root;
-	  Op op;
-	  Item* w;
-	  Item* t1;
-	  Item* t2;
-
-      Pattern* try_to_cover(Tree *i, std::vector<Tile*>& all) override;
-      std::string printer() override;
+      int cover(Function* f, Node i, Match& m, std::vector<Node>& kids) override;
+      std::string printer(Program& p, Function* f, const Match& m) override;
   };
 
-  class Tile4_Asmt : public Tile {
+  class Tile4_Asmt : public Tile {   // items: w s
     public :
-      Tile4_Asmt(){};
-
-      Tile4_Asmt(Item* w, Item* s);
-      Item* w;
-      Item* s;
-
-      Pattern* try_to_cover(Tree *i, std::vector<Tile*>& all) override;
-      std::string printer() override;
+      int cover(Function* f, Node i, Match& m, std::vector<Node>& kids) override;
+      std::string printer(Program& p, Function* f, const Match& m) override;
   };
 
-  class Tile4_Cmp : public Tile {
+  class Tile4_Cmp : public Tile {   // items: w t1 t2, op: cmp
     public :
-      Tile4_Cmp(){};
-
-      Tile4_Cmp(Item* w, Item* t1, Item* t2, Op cmp);
-      int64_t root;
-	  Op cmp;
-	  Item* w;
-	  Item* t1;
-	  Item* t2;
-
-      Pattern* try_to_cover(Tree *i, std::vector<Tile*>& all) override;
-      std::string printer() override;
+      int cover(Function* f, Node i, Match& m, std::vector<Node>& kids) override;
+      std::string printer(Program& p, Function* f, const Match& m) override;
   };
 
-  class Tile4_Ret : public Tile {
+  class Tile4_Ret : public Tile {   // items: t, NONE without a value
     public :
-      Tile4_Ret(){};
-
-      Tile4_Ret(Item* t);
-      Item* t;
-
-      Pattern* try_to_cover(Tree *i, std::vector<Tile*>& all) override;
-      std::string printer() override;
+      int cover(Function* f, Node i, Match& m, std::vector<Node>& kids) override;
+      std::string printer(Program& p, Function* f, const Match& m) override;
   };
 
-  class Tile4_Label : public Tile {
+  class Tile4_Label : public Tile {   // items: label, op: br or label
     public :
-      Tile4_Label(){};
-
-      Tile4_Label(Item* label, Op op);
-      Item* label;
-      Op op;
-
-      Pattern* try_to_cover(Tree *i, std::vector<Tile*>& all) override;
-      std::string printer() override;
+      int cover(Function* f, Node i, Match& m, std::vector<Node>& kids) override;
+      std::string printer(Program& p, Function* f, const Match& m) override;
   };
 
-  class Tile4_Call : public Tile {
+  class Tile4_Call : public Tile {   // printed from the call node itself
     public :
-      Tile4_Call(){};
-
-      Tile4_Call(Tree* t);
-      Tree* t;
-
-      Pattern* try_to_cover(Tree *i, std::vector<Tile*>& all) override;
-      std::string printer() override; 
+      int cover(Function* f, Node i, Match& m, std::vector<Node>& kids) override;
+      std::string printer(Program& p, Function* f, const Match& m) override;
   };
 
-}
\ No newline at end of file
+}
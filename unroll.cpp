@@ -0,0 +1,380 @@
+#include <algorithm>
+#include <map>
+
+#include <unroll.h>
+#include <report.h>
+
+namespace L3 {
+
+    /* a loop run by a counter compared with an invariant in its header, and what unrolling it takes */
+    class Counted {
+      public:
+        int loop;
+        int first;            // instructions of the body, from the label the header branches to up to the back edge
+        int last;
+        Node head;            // label of the header
+        Node test;            // compare of the header
+        int side;             // leaf of the compare reading the counter
+        int64_t step;
+        int factor;           // copies of the body
+        int64_t ahead;        // steps of the counter over all the copies but one
+        int jumps;            // trees of the body jumping to the header, the back edge ending it aside
+        Item guard;           // label of the guard ahead of the header
+    };
+
+    class Unroll {
+      public:
+        Unroll (Program& p, Function* f, Analyses& a, int budget, int factor, UnrollStats& stats);
+
+        bool plan();
+        void rewrite();
+
+      private:
+        bool counted(int l, Counted& c);
+        bool fits(Counted& c);
+        void copies(const Counted& c, const std::vector<Context*>& body, std::vector<Context*>& contexts);
+
+        Program& p;
+        Function* f;
+        TreePool& T;
+        CFG& g;
+        DomTree& D;
+        LoopForest& F;
+        Liveness& L;
+        int budget;
+        int factor;
+        UnrollStats& stats;
+
+        std::vector<int> inside;        // defs of each var in the loop being looked at
+        std::vector<bool> outer;        // loops containing another one
+        std::vector<bool> starts;       // instructions first in their context
+        std::vector<bool> ends;         // instructions last in their context
+        std::vector<Counted> loops;     // to unroll
+    };
+
+    Unroll::Unroll (Program& p, Function* f, Analyses& a, int budget, int factor, UnrollStats& stats)
+      : p {p},
+        f {f},
+        T {f->trees},
+        g {a.cfg(f)},
+        D {a.dominators(f)},
+        F {a.loops(f)},
+        L {a.liveness(f)},
+        budget {budget},
+        factor {factor},
+        stats {stats},
+        inside (L.bits, 0),
+        outer (F.loops.size(), false),
+        starts (g.size, false),
+        ends (g.size, false) {
+        for (auto& loop : F.loops) {
+            if (loop.parent >= 0) {
+                outer[loop.parent] = true;
+            }
+        }
+        for (auto c : f->contexts) {
+            starts[T.id_in_func[c->trees.front()]] = true;
+            ends[T.id_in_func[c->trees.back()]] = true;
+        }
+    }
+
+    /* the loops to unroll and the jumps into them retargeted to their guards, true when there are some */
+    bool Unroll::plan() {
+        for (int l = 0; l < (int)F.loops.size(); l++) {
+            if (outer[l]) {
+                continue;
+            }
+            auto& loop = F.loops[l];
+            for (auto b : loop.blocks) {
+                for (int i = g.first[b]; i <= g.last[b]; i++) {
+                    if (g.inst[i] != NIL && L.KILL[i] >= 0) {
+                        inside[L.KILL[i]]++;
+                    }
+                }
+            }
+            Counted c;
+            if (counted(l, c)) {
+                stats.counted++;
+                int trees = 0;
+                for (int i = c.first; i <= c.last; i++) {
+                    trees += g.inst[i] != NIL;
+                }
+                c.factor = std::min(factor, budget / trees);
+                if (c.factor >= 2 && fits(c)) {
+                    loops.push_back(c);
+                    stats.unrolled++;
+                    stats.copies += c.factor;
+                    stats.trees += c.factor * trees;
+                }
+            }
+            for (auto b : loop.blocks) {
+                for (int i = g.first[b]; i <= g.last[b]; i++) {
+                    if (g.inst[i] != NIL && L.KILL[i] >= 0) {
+                        inside[L.KILL[i]] = 0;
+                    }
+                }
+            }
+        }
+
+        /* the way into each loop from outside is through its guard now */
+        for (auto& c : loops) {
+            c.guard = Label(++p.global_label_count);
+            int h = F.loops[c.loop].header;
+            for (auto b : g.pred[h]) {
+                auto t = g.inst[g.last[b]];
+                if (F.contains(c.loop, b) || t == NIL || (T.op[t] != Op::br && T.op[t] != Op::cjmp) || T.root[t] != T.root[c.head]) {
+                    continue;
+                }
+                T.root[t] = c.guard;
+            }
+        }
+        return !loops.empty();
+    }
+
+    /*
+     * loop l is counted: its header is a label, a compare and a branch into the body, the compare reads an invariant
+     * and a counter the body steps once per iteration by a constant moving it towards failing the test,
+     * the body is the run of blocks from the branch target to the back edge ending it, with no block of another loop in it
+     */
+    bool Unroll::counted(int l, Counted& c) {
+        auto& loop = F.loops[l];
+        int h = loop.header;
+        std::vector<Node> head;
+        for (int i = g.first[h]; i <= g.last[h]; i++) {
+            if (g.inst[i] != NIL) {
+                head.push_back(g.inst[i]);
+            }
+        }
+        if (head.size() != 3 || T.op[head[0]] != Op::label || T.op[head[2]] != Op::cjmp) {
+            return false;
+        }
+        auto t = head[1];
+        auto o = T.op[t];
+        if ((o != Op::c_l && o != Op::c_le) || T.op[T.left[t]] != Op::leaf || T.op[T.right[t]] != Op::leaf) {
+            return false;
+        }
+        if (T.root[T.left[head[2]]] != T.root[t]) {
+            return false;
+        }
+
+        /* the body */
+        int s = g.block_of[f->label_id_map.find(T.root[head[2]].getval())->second];
+        int e = loop.blocks.back();
+        if (loop.blocks.size() < 2 || loop.blocks[0] != h || loop.blocks[1] < s || s <= h) {
+            return false;
+        }
+        auto back = g.inst[g.last[e]];
+        if (back == NIL || T.op[back] != Op::br || T.root[back] != T.root[head[0]]) {
+            return false;
+        }
+        c.loop = l;
+        c.first = g.first[s];
+        c.last = g.last[e];
+        c.head = head[0];
+        c.test = t;
+        c.jumps = 0;
+        if (!starts[c.first] || !ends[c.last]) {
+            return false;
+        }
+        for (int b = s; b <= e; b++) {
+            if (F.loop_of[b] >= 0 && !F.contains(F.loop_of[b], h)) {
+                return false;
+            }
+        }
+        for (int i = c.first; i <= c.last; i++) {
+            auto u = g.inst[i];
+            if (u == NIL) {
+                continue;
+            }
+            if (HoldsLabel(T, u)) {
+                return false;
+            }
+            if ((T.op[u] == Op::br || T.op[u] == Op::cjmp) && T.root[u] == T.root[head[0]] && i != c.last) {
+                c.jumps++;
+            }
+        }
+        if (L.flow.IN.test(s, T.root[t].getval())) {
+            return false;
+        }
+
+        /* the counter and the invariant it is compared with */
+        for (c.side = 0; c.side < 2; c.side++) {
+            auto x = T.root[T.leaf(t, c.side)];
+            auto y = T.root[T.leaf(t, 1 - c.side)];
+            if (x.type != VAR || inside[x.getval()] != 1 || x == T.root[t]) {
+                continue;
+            }
+            if (y.type != NUM && (y.type != VAR || inside[y.getval()] != 0)) {
+                continue;
+            }
+            int def = -1;
+            for (auto b : loop.blocks) {
+                for (int i = g.first[b]; i <= g.last[b]; i++) {
+                    if (g.inst[i] != NIL && L.KILL[i] == x.getval()) {
+                        def = i;
+                    }
+                }
+            }
+            auto d = g.inst[def];
+            auto op = T.op[d];
+            if (op != Op::add && op != Op::addn && op != Op::sub && op != Op::subn) {
+                continue;
+            }
+            if (T.op[T.left[d]] != Op::leaf || T.op[T.right[d]] != Op::leaf) {
+                continue;
+            }
+            auto a = T.root[T.left[d]];
+            auto n = T.root[T.right[d]];
+            if ((op == Op::add || op == Op::addn) && a.type == NUM) {
+                std::swap(a, n);
+            }
+            if (a != x || n.type != NUM || n.getval() == 0) {
+                continue;
+            }
+            c.step = op == Op::add || op == Op::addn ? n.getval() : arithmetic(0, n.getval(), Op::sub);
+
+            /* stepped on every iteration, towards failing the test */
+            bool every = g.block_of[def] != h;
+            for (auto b : loop.latches) {
+                every = every && D.dominates(g.block_of[def], b);
+            }
+            if (every && (c.side == 0 ? c.step > 0 : c.step < 0)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /* the steps over all the copies but one, and a constant bound moved back by them, do not wrap around */
+    bool Unroll::fits(Counted& c) {
+        if (__builtin_mul_overflow(int64_t(c.factor - 1), c.step, &c.ahead)) {
+            return false;
+        }
+        auto y = T.root[T.leaf(c.test, 1 - c.side)];
+        int64_t n;
+        return y.type != NUM || !__builtin_sub_overflow(y.getval(), c.ahead, &n);
+    }
+
+    /*
+     * the guard and the copies of the body ahead of the header, the guard jumping to the header
+     * unless every copy passes the test, the last copy jumping back to the guard
+     *   the counter is compared as it is with a constant bound moved back by the steps of the copies,
+     *   and with an invariant once it is checked not to wrap around on its way there
+     */
+    void Unroll::copies(const Counted& c, const std::vector<Context*>& body, std::vector<Context*>& contexts) {
+        auto t = c.test;
+        auto lc = p.arena.make<Context>();
+        lc->trees.push_back(T.make(c.guard, Op::label));
+        contexts.push_back(lc);
+        auto counter = T.root[T.leaf(t, c.side)];
+        auto bound = T.root[T.leaf(t, 1 - c.side)];
+        auto v = Var(++f->var_count);
+        auto gc = p.arena.make<Context>();
+        if (bound.type == NUM) {
+            bound = Num(bound.getval() - c.ahead);
+        } else {
+            auto w = Var(++f->var_count);
+            auto edge = T.make(Num(c.step > 0 ? INT64_MAX - c.ahead : INT64_MIN - c.ahead), Op::leaf);
+            auto far = c.step > 0 ? T.make(w, Op::c_l, edge, T.make(counter, Op::leaf)) : T.make(w, Op::c_l, T.make(counter, Op::leaf), edge);
+            auto wc = p.arena.make<Context>();
+            wc->trees = {far, T.make(T.root[c.head], Op::cjmp, T.make(w, Op::leaf))};
+            contexts.push_back(wc);
+            auto u = Var(++f->var_count);
+            gc->trees.push_back(T.make(u, Op::addn, T.make(counter, Op::leaf), T.make(Num(c.ahead), Op::leaf)));
+            counter = u;
+        }
+        auto x = c.side == 0 ? counter : bound;
+        auto y = c.side == 1 ? counter : bound;
+        gc->trees.push_back(T.make(v, T.op[t] == Op::c_l ? Op::c_le : Op::c_l, T.make(y, Op::leaf), T.make(x, Op::leaf)));
+        gc->trees.push_back(T.make(T.root[c.head], Op::cjmp, T.make(v, Op::leaf)));
+        contexts.push_back(gc);
+
+        /* fresh labels of each copy, the header being the start of the next copy */
+        auto entry = T.root[g.inst[c.first]].getval();
+        std::vector<std::map<int64_t, int64_t>> labels (c.factor);
+        for (int k = 0; k < c.factor; k++) {
+            for (int i = c.first; i <= c.last; i++) {
+                auto w = g.inst[i];
+                if (w == NIL) {
+                    continue;
+                }
+                if (T.op[w] == Op::label) {
+                    labels[k][T.root[w].getval()] = ++p.global_label_count;
+                } else if (T.op[w] == Op::call) {
+                    labels[k][T.root[T.leaf(w, T.size(w) - 2)].getval()] = ++p.global_label_count;
+                }
+            }
+        }
+        for (int k = 0; k < c.factor; k++) {
+            labels[k][T.root[c.head].getval()] = k + 1 < c.factor ? labels[k + 1][entry] : c.guard.getval();
+        }
+
+        /* one copy falls into the next, the back edge between them and the label of the next one go when nothing else jumps there */
+        for (int k = 0; k < c.factor; k++) {
+            auto rename = [&](Item x) {
+                auto it = x.type == LABEL ? labels[k].find(x.getval()) : labels[k].end();
+                return it != labels[k].end() ? Label(it->second) : x;
+            };
+            for (auto ctx : body) {
+                std::vector<Node> trees;
+                for (auto w : ctx->trees) {
+                    int i = T.id_in_func[w];
+                    bool dropped = (i == c.last && k + 1 < c.factor) || (i == c.first && (k == 0 || c.jumps == 0));
+                    if (dropped) {
+                        stats.jumps += i == c.last || k > 0;
+                        continue;
+                    }
+                    trees.push_back(CopyTree(T, w, T, rename));
+                }
+                Place(p, f, contexts, trees);
+            }
+        }
+    }
+
+    void Unroll::rewrite() {
+        std::vector<int> head (g.size, -1);
+        std::vector<int> body (g.size, -1);
+        for (int k = 0; k < (int)loops.size(); k++) {
+            head[T.id_in_func[loops[k].head]] = k;
+            std::fill(body.begin() + loops[k].first, body.begin() + loops[k].last + 1, k);
+        }
+        std::vector<std::vector<Context*>> bodies (loops.size());
+        for (auto c : f->contexts) {
+            int k = body[T.id_in_func[c->trees.front()]];
+            if (k >= 0) {
+                bodies[k].push_back(c);
+            }
+        }
+        std::vector<Context*> contexts;
+        for (auto c : f->contexts) {
+            int k = head[T.id_in_func[c->trees.front()]];
+            if (k >= 0) {
+                copies(loops[k], bodies[k], contexts);
+            }
+            contexts.push_back(c);
+        }
+        f->contexts = contexts;
+        Renumber(f);
+    }
+
+    UnrollStats UnrollLoops(Program& p, Analyses& a, int budget, int factor) {
+        UnrollStats stats;
+        for (auto f : p.functions) {
+            report.begin_function(f->name);
+            if (a.cfg(f).blocks() > 0) {
+                Unroll u (p, f, a, budget, factor, stats);
+                if (u.plan()) {
+                    u.rewrite();
+                }
+            }
+            report.end_function();
+        }
+        return stats;
+    }
+
+    /* the copies of a body, before merging, take up to 256 trees copied up to 4 times at -O2, twice as much per level above */
+    void UnrollPass::run(Program& p, Analyses& a, int optLevel) {
+        stats = UnrollLoops(p, a, 64 << optLevel, 1 << optLevel);
+    }
+
+}
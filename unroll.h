@@ -0,0 +1,37 @@
+#pragma once
+
+#include <L3.h>
+#include <passes.h>
+
+namespace L3 {
+
+  class UnrollStats {
+    public:
+      int64_t counted = 0;    // innermost loops whose header only compares a counter with an invariant
+      int64_t unrolled = 0;   // of which small enough to copy at least twice
+      int64_t copies = 0;     // bodies added ahead of the loops unrolled
+      int64_t trees = 0;      // trees of those bodies
+      int64_t jumps = 0;      // back edges and labels between two copies removed
+  };
+
+  UnrollStats UnrollLoops(Program& p, Analyses& a, int budget, int factor);
+
+  /*
+   * unrolling of counted loops, ahead of merging
+   *   an innermost loop whose header is a label, a compare of a counter with an invariant and a branch into the body
+   *   is copied k times, the body being the run of blocks from the branch target to the back edge ending the loop,
+   *   k at most factor and k copies at most budget trees, with the labels of each copy fresh
+   *   a guard ahead of the header runs the copies straight one into the other while the counter k - 1 steps ahead
+   *   still passes the test, then falls back to the loop left as it was for the iterations remaining,
+   *   the test moving a constant bound back by those steps, or first checking the counter is that far from wrapping around
+   */
+  class UnrollPass : public Pass {
+    public:
+      UnrollPass () : Pass ("unroll", 2, {}, 0) {}
+
+      void run(Program& p, Analyses& a, int optLevel) override;
+
+      UnrollStats stats;
+  };
+
+}